@@ -0,0 +1,92 @@
+<?php
+
+// Measures the cost of building result arrays. Each function returning a
+// list of cells is timed with H3_FORMAT_ARRAY and with H3_FORMAT_PACKED; the
+// difference is the array construction, shown per element. Save a run on
+// one build and compare another build against it to see the gain:
+//
+// usage: php benchmarks/arrays.php [--save=file.json] [--baseline=file.json]
+
+$options = getopt('', ['save:', 'baseline:']);
+
+function now()
+{
+	return function_exists('hrtime') ? hrtime(true) : microtime(true) * 1e9;
+}
+
+function measure($function, $args, $budget = 0.3)
+{
+	$start = now();
+	$function(...$args);
+	$iterations = (int)max(3, min(100000, $budget * 1e9 / max(now() - $start, 1)));
+
+	$start = now();
+	for ($i = 0; $i < $iterations; $i++) {
+		$result = $function(...$args);
+	}
+
+	return (now() - $start) / $iterations;
+}
+
+$cell = geoToH3(40.689167, -74.044444, 9);
+$parent = h3ToParent($cell, 5);
+$fence = [];
+for ($i = 0; $i < 64; $i++) {
+	$angle = 2 * M_PI * $i / 64;
+	$fence[] = ['lat' => 40.689167 + 0.2 * sin($angle), 'lon' => -74.044444 + 0.2 * cos($angle)];
+}
+$polygon = new H3Polygon(['geofence' => $fence]);
+$compacted = h3Compact(kRing($cell, 50));
+
+// name => [function, arguments before the format]; the element count is
+// taken from the array result
+$cases = [
+	'kRing k=50' => ['kRing', [$cell, 50]],
+	'hexRange k=50' => ['hexRange', [$cell, 50]],
+	'hexRing k=50' => ['hexRing', [$cell, 50]],
+	'h3ToChildren +5' => ['h3ToChildren', [$parent, 10]],
+	'uncompact' => ['uncompact', [$compacted, 10]],
+	'polyfill res 10' => ['polyfill', [$polygon, 10]],
+];
+
+$results = [];
+printf("%-20s %10s %14s %14s %12s %12s\n", 'case', 'elements', 'array ns/op', 'packed ns/op', 'ns/element', 'baseline');
+
+foreach ($cases as $name => $case) {
+	list($function, $args) = $case;
+	$elements = count($function(...$args));
+
+	$array = measure($function, array_merge($args, [H3_FORMAT_ARRAY]));
+	$packed = measure($function, array_merge($args, [H3_FORMAT_PACKED]));
+	$perElement = ($array - $packed) / max($elements, 1);
+	$results[$name] = $array;
+
+	printf("%-20s %10d %14.0f %14.0f %12.2f", $name, $elements, $array, $packed, $perElement);
+	if (isset($options['baseline'])) {
+		$baseline = json_decode(file_get_contents($options['baseline']), true);
+		if (isset($baseline[$name])) {
+			printf(" %11.2fx", $baseline[$name] / $array);
+		}
+	}
+	echo "\n";
+}
+
+// kRingDistances() and hexRangeDistances() have no packed format, so only
+// the absolute time is comparable between builds
+foreach (['kRingDistances' => [$cell, 50], 'hexRangeDistances' => [$cell, 50]] as $function => $args) {
+	$name = $function . ' k=50';
+	$results[$name] = measure($function, $args);
+
+	printf("%-20s %10d %14.0f %14s %12s", $name, count($function(...$args)[0]), $results[$name], '-', '-');
+	if (isset($options['baseline'])) {
+		$baseline = json_decode(file_get_contents($options['baseline']), true);
+		if (isset($baseline[$name])) {
+			printf(" %11.2fx", $baseline[$name] / $results[$name]);
+		}
+	}
+	echo "\n";
+}
+
+if (isset($options['save'])) {
+	file_put_contents($options['save'], json_encode($results, JSON_PRETTY_PRINT) . "\n");
+}
@@ -0,0 +1,54 @@
+<?php
+
+// Compares the per-point cost of geoToH3() in a userland loop against
+// geoToH3Batch() with parallel arrays and with a packed float64 buffer.
+//
+// usage: php benchmarks/geoToH3Batch.php [points] [resolution]
+
+$points = isset($argv[1]) ? (int)$argv[1] : 1000000;
+$res = isset($argv[2]) ? (int)$argv[2] : 9;
+
+// Dense urban pings around lower Manhattan.
+mt_srand(42);
+$lats = [];
+$lons = [];
+for ($i = 0; $i < $points; $i++) {
+	$lats[] = 40.70 + mt_rand() / mt_getrandmax() * 0.1;
+	$lons[] = -74.02 + mt_rand() / mt_getrandmax() * 0.1;
+}
+
+$packed = '';
+for ($i = 0; $i < $points; $i++) {
+	$packed .= pack('dd', $lats[$i], $lons[$i]);
+}
+
+function now()
+{
+	return function_exists('hrtime') ? hrtime(true) : microtime(true) * 1e9;
+}
+
+function report($label, $points, $start)
+{
+	$elapsed = now() - $start;
+	printf("%-24s %10.1f ns/point\n", $label, $elapsed / $points);
+}
+
+$start = now();
+$scalar = [];
+for ($i = 0; $i < $points; $i++) {
+	$scalar[] = geoToH3($lats[$i], $lons[$i], $res);
+}
+report('geoToH3 (loop)', $points, $start);
+
+$start = now();
+$batch = geoToH3Batch($lats, $lons, $res);
+report('geoToH3Batch (arrays)', $points, $start);
+
+$start = now();
+$batchPacked = geoToH3Batch($packed, $res);
+report('geoToH3Batch (packed)', $points, $start);
+
+if ($scalar !== $batch || $scalar !== $batchPacked) {
+	echo "batch results differ from geoToH3\n";
+	exit(1);
+}
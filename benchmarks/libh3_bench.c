@@ -0,0 +1,148 @@
+/*
+  Times the libh3 calls behind the benchmarks in run.php on the same inputs,
+  so that run.php --libh3 can show the cost the binding adds on top of them.
+  Prints one "case ns/op" line per operation, with the spaces of run.php case
+  names replaced by underscores.
+
+  build: cc -O2 -o libh3_bench benchmarks/libh3_bench.c -lh3 -lm
+  usage: ./libh3_bench [seconds per case]
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <h3/h3api.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define POINTS 10000
+
+static double budget = 0.2;
+static volatile H3Index sink;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Runs body once to calibrate, then for about budget seconds, and prints the
+// time per run.
+#define BENCH(name, body)                                                    \
+    do                                                                       \
+    {                                                                        \
+        double start = now(), single;                                        \
+        long iterations;                                                     \
+        {                                                                    \
+            body;                                                            \
+        }                                                                    \
+        single = now() - start;                                              \
+        iterations = (long)(budget * 1e9 / (single > 1 ? single : 1));       \
+        iterations = iterations < 1 ? 1 : (iterations > 1000000 ? 1000000 : iterations); \
+        start = now();                                                       \
+        for (long iteration = 0; iteration < iterations; iteration++)        \
+        {                                                                    \
+            body;                                                            \
+        }                                                                    \
+        printf("%s %.1f\n", name, (now() - start) / iterations);             \
+    } while (0)
+
+static GeoCoord coord(double lat, double lon)
+{
+    GeoCoord c = {degsToRads(lat), degsToRads(lon)};
+    return c;
+}
+
+int main(int argc, char **argv)
+{
+    static GeoCoord points[POINTS];
+    static H3Index set[2000], scratch[200000], compacted[2000];
+    static int distances[200000];
+    static char string[17];
+    GeoCoord fence_verts[256], center;
+    GeoBoundary boundary;
+    Geofence fence = {256, fence_verts};
+    GeoPolygon polygon = {fence, 0, NULL};
+    LinkedGeoPolygon linked;
+
+    if (argc > 1)
+    {
+        budget = atof(argv[1]);
+    }
+
+    srand(42);
+    for (int i = 0; i < POINTS; i++)
+    {
+        points[i] = coord(40.70 + rand() / (double)RAND_MAX * 0.1, -74.02 + rand() / (double)RAND_MAX * 0.1);
+    }
+    for (int i = 0; i < 256; i++)
+    {
+        double angle = 2 * M_PI * i / 256;
+        fence_verts[i] = coord(40.689167 + 0.1 * sin(angle), -74.044444 + 0.1 * cos(angle));
+    }
+
+    GeoCoord origin = coord(40.689167, -74.044444), other = coord(40.75, -73.98);
+    H3Index cell = geoToH3(&origin, 9);
+    H3Index far = geoToH3(&other, 9);
+    H3Index pentagons[12], edges[6];
+    getPentagonIndexes(9, pentagons);
+    kRing(pentagons[0], 1, scratch);
+    H3Index pentagon_neighbour = scratch[1];
+    getH3UnidirectionalEdgesFromHexagon(cell, edges);
+    H3Index edge = edges[0];
+
+    int set_size = maxKringSize(20);
+    kRing(cell, 20, set);
+    compact(set, compacted, set_size);
+    int compacted_size = 0;
+    while (compacted_size < set_size && compacted[compacted_size] != 0)
+    {
+        compacted_size++;
+    }
+    h3ToString(cell, string, sizeof(string));
+
+    BENCH("geoToH3", sink = geoToH3(&origin, 9));
+    BENCH("geoToH3Batch", for (int i = 0; i < POINTS; i++) sink = geoToH3(&points[i], 9));
+    BENCH("h3ToGeo", h3ToGeo(cell, &center));
+    BENCH("h3ToGeoBoundary", h3ToGeoBoundary(cell, &boundary));
+    BENCH("h3ToGeoBatch", for (int i = 0; i < set_size; i++) h3ToGeo(set[i], &center));
+    BENCH("h3ToGeoBoundaryBatch", for (int i = 0; i < set_size; i++) h3ToGeoBoundary(set[i], &boundary));
+    BENCH("h3GetResolution", sink = h3GetResolution(cell));
+    BENCH("stringToH3", sink = stringToH3(string));
+    BENCH("h3ToString", h3ToString(cell, string, sizeof(string)));
+    BENCH("h3IsValid", sink = h3IsValid(cell));
+    BENCH("h3IsPentagon", sink = h3IsPentagon(cell));
+    BENCH("kRing", kRing(cell, 10, scratch));
+    BENCH("kRing_pentagon", (memset(scratch, 0, maxKringSize(10) * sizeof(H3Index)), kRing(pentagon_neighbour, 10, scratch)));
+    BENCH("kRingFast", hexRange(cell, 10, scratch));
+    BENCH("kRingDistances", kRingDistances(cell, 10, scratch, distances));
+    BENCH("hexRange", hexRange(cell, 10, scratch));
+    BENCH("hexRing", hexRing(cell, 10, scratch));
+    BENCH("h3Line", h3Line(cell, far, scratch));
+    BENCH("h3LineSize", sink = h3LineSize(cell, far));
+    BENCH("h3Distance", sink = h3Distance(cell, far));
+    BENCH("h3DistanceBatch", for (int i = 0; i < set_size; i++) sink = h3Distance(cell, set[i]));
+    BENCH("h3LineSizeBatch", for (int i = 0; i < set_size; i++) sink = h3LineSize(set[i], set[set_size - 1 - i]));
+    BENCH("h3ToParent", sink = h3ToParent(cell, 5));
+    BENCH("h3ToChildren", h3ToChildren(cell, 13, scratch));
+    BENCH("h3Compact", compact(set, scratch, set_size));
+    BENCH("uncompact", uncompact(compacted, compacted_size, scratch, maxUncompactSize(compacted, compacted_size, 9), 9));
+    BENCH("getH3UnidirectionalEdgesFromHexagon", getH3UnidirectionalEdgesFromHexagon(cell, edges));
+    BENCH("getH3UnidirectionalEdgeBoundary", getH3UnidirectionalEdgeBoundary(edge, &boundary));
+    BENCH("polyfill", (memset(scratch, 0, maxPolyfillSize(&polygon, 9) * sizeof(H3Index)), polyfill(&polygon, 9, scratch)));
+    BENCH("maxPolyfillSize", sink = maxPolyfillSize(&polygon, 9));
+    BENCH("h3SetToLinkedGeo", (h3SetToLinkedGeo(set, set_size, &linked), destroyLinkedPolygon(&linked)));
+    BENCH("cellAreaKm2", sink = (H3Index)cellAreaKm2(cell));
+    BENCH("exactEdgeLengthM", sink = (H3Index)exactEdgeLengthM(edge));
+    BENCH("pointDistKm", sink = (H3Index)pointDistKm(&origin, &other));
+
+    return 0;
+}
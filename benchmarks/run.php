@@ -0,0 +1,231 @@
+<?php
+
+// Times every function exported by the extension on representative inputs
+// and reports ns/op, the memory held by one result and the peak memory of
+// the run. With --libh3 the same operations are timed through libh3 by the
+// C driver in libh3_bench.c and the binding overhead is shown next to them.
+//
+// PHP has no counter for allocations on the Zend heap, so the only
+// allocation count shown is scratch buffers that missed the arena and went
+// to malloc(), per op. Run with -d h3.arena_size=0 to count every scratch
+// buffer. Result zvals, arrays and strings, and the few buffers malloc()ed
+// outside the arena, are not counted.
+//
+// usage: php benchmarks/run.php [--filter=regex] [--time=seconds] [--libh3=path/to/libh3_bench]
+//
+// Build the driver with: cc -O2 -o libh3_bench benchmarks/libh3_bench.c -lh3 -lm
+
+$options = getopt('', ['filter:', 'time:', 'libh3:']);
+$filter = isset($options['filter']) ? $options['filter'] : null;
+$budget = isset($options['time']) ? (float)$options['time'] : 0.2;
+
+function now()
+{
+	return function_exists('hrtime') ? hrtime(true) : microtime(true) * 1e9;
+}
+
+// Inputs. Every case below uses these so that the C driver can build the
+// same ones: dense urban points, a cell next to a pentagon and a large
+// polygon, all around lower Manhattan.
+mt_srand(42);
+$points = 10000;
+$lats = [];
+$lons = [];
+$packedPoints = '';
+for ($i = 0; $i < $points; $i++) {
+	$lats[] = 40.70 + mt_rand() / mt_getrandmax() * 0.1;
+	$lons[] = -74.02 + mt_rand() / mt_getrandmax() * 0.1;
+	$packedPoints .= pack('dd', $lats[$i], $lons[$i]);
+}
+
+$cell = geoToH3(40.689167, -74.044444, 9);
+$far = geoToH3(40.75, -73.98, 9);
+$neighbour = kRing($cell, 1)[1];
+$pentagon = getPentagonIndexes(9)[0];
+$pentagonNeighbour = kRing($pentagon, 1)[1];
+$edge = getH3UnidirectionalEdge($cell, $neighbour);
+$ij = experimentalH3ToLocalIj($cell, $far);
+
+$set = kRing($cell, 20);
+$packedSet = pack('P*', ...$set);
+$indexSet = kRing($cell, 20, H3_FORMAT_SET);
+$otherSet = kRing($neighbour, 20);
+$compacted = h3Compact(kRing(h3ToParent($cell, 7), 2, H3_FORMAT_SET));
+$compactedArray = iterator_to_array($compacted);
+
+// a 256 vertex circle of 0.1 degrees around the Statue of Liberty
+$fence = [];
+for ($i = 0; $i < 256; $i++) {
+	$angle = 2 * M_PI * $i / 256;
+	$fence[] = ['lat' => 40.689167 + 0.1 * sin($angle), 'lon' => -74.044444 + 0.1 * cos($angle)];
+}
+$geopolygon = ['geofence' => $fence];
+$polygon = new H3Polygon($geopolygon);
+
+$a = ['lat' => 40.689167, 'lon' => -74.044444];
+$b = ['lat' => 40.75, 'lon' => -73.98];
+
+// name => [function, arguments]; names containing a space are extra inputs
+// for a function already listed
+$cases = [
+	'geoToH3' => ['geoToH3', [40.689167, -74.044444, 9]],
+	'geoToH3Batch' => ['geoToH3Batch', [$lats, $lons, 9]],
+	'geoToH3Batch packed' => ['geoToH3Batch', [$packedPoints, 9]],
+	'h3ToGeo' => ['h3ToGeo', [$cell]],
+	'h3ToGeoBoundary' => ['h3ToGeoBoundary', [$cell]],
+	'h3ToGeoBatch' => ['h3ToGeoBatch', [$packedSet]],
+	'h3ToGeoBoundaryBatch' => ['h3ToGeoBoundaryBatch', [$packedSet]],
+	'h3GetResolution' => ['h3GetResolution', [$cell]],
+	'h3GetBaseCell' => ['h3GetBaseCell', [$cell]],
+	'stringToH3' => ['stringToH3', [dechex($cell)]],
+	'h3ToString' => ['h3ToString', [$cell]],
+	'h3IsValid' => ['h3IsValid', [$cell]],
+	'h3IsResClassIII' => ['h3IsResClassIII', [$cell]],
+	'h3IsPentagon' => ['h3IsPentagon', [$cell]],
+	'h3GetFaces' => ['h3GetFaces', [$cell]],
+	'maxFaceCount' => ['maxFaceCount', [$cell]],
+	'kRing' => ['kRing', [$cell, 10]],
+	'kRing packed' => ['kRing', [$cell, 10, H3_FORMAT_PACKED]],
+	'kRing pentagon' => ['kRing', [$pentagonNeighbour, 10]],
+	'kRingFast' => ['kRingFast', [$cell, 10]],
+	'kRingFast pentagon' => ['kRingFast', [$pentagonNeighbour, 10]],
+	'maxKringSize' => ['maxKringSize', [10]],
+	'kRingDistances' => ['kRingDistances', [$cell, 10]],
+	'hexRange' => ['hexRange', [$cell, 10]],
+	'hexRangeDistances' => ['hexRangeDistances', [$cell, 10]],
+	'hexRanges' => ['hexRanges', [array_slice($set, 0, 100), 2]],
+	'hexRing' => ['hexRing', [$cell, 10]],
+	'h3Line' => ['h3Line', [$cell, $far]],
+	'h3LineSize' => ['h3LineSize', [$cell, $far]],
+	'h3Distance' => ['h3Distance', [$cell, $far]],
+	'h3DistanceBatch' => ['h3DistanceBatch', [$cell, $packedSet]],
+	'h3LineSizeBatch' => ['h3LineSizeBatch', [$packedSet, pack('P*', ...array_reverse($set))]],
+	'experimentalH3ToLocalIj' => ['experimentalH3ToLocalIj', [$cell, $far]],
+	'experimentalLocalIjToH3' => ['experimentalLocalIjToH3', [$cell, $ij]],
+	'h3ToParent' => ['h3ToParent', [$cell, 5]],
+	'h3ToChildren' => ['h3ToChildren', [$cell, 13]],
+	'maxH3ToChildrenSize' => ['maxH3ToChildrenSize', [$cell, 13]],
+	'h3ToCenterChild' => ['h3ToCenterChild', [$cell, 13]],
+	'h3Compact' => ['h3Compact', [$set]],
+	'h3Compact set' => ['h3Compact', [$indexSet]],
+	'uncompact' => ['uncompact', [$compactedArray, 9]],
+	'maxUncompactSize' => ['maxUncompactSize', [$compactedArray, 9]],
+	'h3SetUnion' => ['h3SetUnion', [$set, $otherSet]],
+	'h3SetIntersection' => ['h3SetIntersection', [$set, $otherSet]],
+	'h3SetDifference' => ['h3SetDifference', [$set, $otherSet]],
+	'h3Rollup' => ['h3Rollup', [$packedSet, null, [8, 7, 6]]],
+	'h3SetToAdjacency' => ['h3SetToAdjacency', [$packedSet, true]],
+	'h3IndexesAreNeighbors' => ['h3IndexesAreNeighbors', [$cell, $neighbour]],
+	'getH3UnidirectionalEdge' => ['getH3UnidirectionalEdge', [$cell, $neighbour]],
+	'h3UnidirectionalEdgeIsValid' => ['h3UnidirectionalEdgeIsValid', [$edge]],
+	'getOriginH3IndexFromUnidirectionalEdge' => ['getOriginH3IndexFromUnidirectionalEdge', [$edge]],
+	'getDestinationH3IndexFromUnidirectionalEdge' => ['getDestinationH3IndexFromUnidirectionalEdge', [$edge]],
+	'getH3IndexesFromUnidirectionalEdge' => ['getH3IndexesFromUnidirectionalEdge', [$edge]],
+	'getH3UnidirectionalEdgesFromHexagon' => ['getH3UnidirectionalEdgesFromHexagon', [$cell]],
+	'getH3UnidirectionalEdgesFromHexagon pentagon' => ['getH3UnidirectionalEdgesFromHexagon', [$pentagon]],
+	'getH3UnidirectionalEdgeBoundary' => ['getH3UnidirectionalEdgeBoundary', [$edge]],
+	'polyfill' => ['polyfill', [$geopolygon, 9]],
+	'polyfill H3Polygon packed' => ['polyfill', [$polygon, 9, H3_FORMAT_PACKED]],
+	'polyfillChunked' => ['polyfillChunked', [$polygon, 9, 4096, H3_FORMAT_PACKED]],
+	'maxPolyfillSize' => ['maxPolyfillSize', [$geopolygon, 9]],
+	'h3SetToLinkedGeo' => ['h3SetToLinkedGeo', [$set]],
+	'h3SetToGeoJson' => ['h3SetToGeoJson', [$set]],
+	'h3SetToWkb' => ['h3SetToWkb', [$set]],
+	'h3ToGeoBoundaryGeoJson' => ['h3ToGeoBoundaryGeoJson', [$set]],
+	'h3ToGeoBoundaryWkb' => ['h3ToGeoBoundaryWkb', [$set]],
+	'h3ToMvt' => ['h3ToMvt', [$set, 12, 1205, 1540]],
+	'degsToRads' => ['degsToRads', [40.689167]],
+	'radsToDegs' => ['radsToDegs', [0.71]],
+	'hexAreaKm2' => ['hexAreaKm2', [9]],
+	'hexAreaM2' => ['hexAreaM2', [9]],
+	'cellAreaKm2' => ['cellAreaKm2', [$cell]],
+	'cellAreaM2' => ['cellAreaM2', [$cell]],
+	'cellAreaRads2' => ['cellAreaRads2', [$cell]],
+	'edgeLengthKm' => ['edgeLengthKm', [9]],
+	'edgeLengthM' => ['edgeLengthM', [9]],
+	'exactEdgeLengthKm' => ['exactEdgeLengthKm', [$edge]],
+	'exactEdgeLengthM' => ['exactEdgeLengthM', [$edge]],
+	'exactEdgeLengthRads' => ['exactEdgeLengthRads', [$edge]],
+	'numHexagons' => ['numHexagons', [9]],
+	'getRes0Indexes' => ['getRes0Indexes', []],
+	'res0IndexCount' => ['res0IndexCount', []],
+	'getPentagonIndexes' => ['getPentagonIndexes', [9]],
+	'pentagonIndexCount' => ['pentagonIndexCount', []],
+	'pointDistKm' => ['pointDistKm', [$a, $b]],
+	'pointDistM' => ['pointDistM', [$a, $b]],
+	'pointDistRads' => ['pointDistRads', [$a, $b]],
+];
+
+// every exported function needs a case
+$covered = [];
+foreach ($cases as $case) {
+	$covered[strtolower($case[0])] = true;
+}
+$missing = [];
+foreach (get_extension_funcs('h3') as $function) {
+	if (!isset($covered[strtolower($function)])) {
+		$missing[] = $function;
+	}
+}
+if ($missing) {
+	fprintf(STDERR, "no benchmark case for: %s\n", implode(', ', $missing));
+}
+
+// ns/op of the same operations called straight through libh3
+$native = [];
+if (isset($options['libh3'])) {
+	exec(escapeshellarg($options['libh3']) . ' ' . escapeshellarg((string)$budget), $lines, $status);
+	if ($status !== 0) {
+		fprintf(STDERR, "%s exited with status %d\n", $options['libh3'], $status);
+		exit(1);
+	}
+	foreach ($lines as $line) {
+		list($name, $ns) = explode(' ', $line);
+		$native[$name] = (float)$ns;
+	}
+}
+
+printf("%-46s %12s %12s %12s %12s %12s %12s\n", 'case', 'ns/op', 'result B', 'peak B', 'mallocs/op', 'libh3 ns/op', 'overhead');
+
+foreach ($cases as $name => $case) {
+	if ($filter !== null && !preg_match('/' . $filter . '/', $name)) {
+		continue;
+	}
+
+	list($function, $args) = $case;
+
+	// the first call warms caches and calibrates the number of iterations
+	$start = now();
+	$result = $function(...$args);
+	$single = max(now() - $start, 1);
+	$iterations = (int)max(1, min(1000000, $budget * 1e9 / $single));
+
+	unset($result);
+	gc_collect_cycles();
+	if (function_exists('memory_reset_peak_usage')) {
+		memory_reset_peak_usage();
+	}
+	$base = memory_get_usage();
+	$basePeak = memory_get_peak_usage();
+	$baseMallocs = h3_arena_stats()['fallbacks'];
+
+	$start = now();
+	for ($i = 0; $i < $iterations; $i++) {
+		$result = $function(...$args);
+	}
+	$ns = (now() - $start) / $iterations;
+	$mallocs = (h3_arena_stats()['fallbacks'] - $baseMallocs) / $iterations;
+
+	// memory still held by the last result, and the highest point reached
+	// while producing them (cumulative on PHP < 8.2)
+	$resultBytes = memory_get_usage() - $base;
+	$peakBytes = memory_get_peak_usage() - $basePeak;
+	unset($result);
+
+	$key = strtr($name, ' ', '_');
+	if (isset($native[$key])) {
+		printf("%-46s %12.1f %12d %12d %12.2f %12.1f %11.1fx\n", $name, $ns, $resultBytes, $peakBytes, $mallocs, $native[$key], $ns / max($native[$key], 0.1));
+	} else {
+		printf("%-46s %12.1f %12d %12d %12.2f %12s %12s\n", $name, $ns, $resultBytes, $peakBytes, $mallocs, '-', '-');
+	}
+}
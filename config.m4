@@ -79,6 +79,12 @@ if test "$PHP_H3" != "no"; then
     -l$LIBNAME
   ])
 
+  dnl worker threads for polyfill(), serial when pthreads are missing
+  AC_CHECK_HEADERS([pthread.h])
+  AC_CHECK_LIB(pthread, pthread_create, [
+    PHP_ADD_LIBRARY(pthread, 1, H3_SHARED_LIBADD)
+  ])
+
   PHP_SUBST(H3_SHARED_LIBADD)
 
   LIBS="-lh3 $LIBS"
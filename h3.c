@@ -23,12 +23,39 @@
 #include "php.h"
 #include "php_ini.h"
 #include "ext/standard/info.h"
+#include "zend_exceptions.h"
+#include "zend_interfaces.h"
+#include "zend_smart_str.h"
+#if PHP_VERSION_ID < 70200
+#include "ext/spl/spl_iterators.h"
+#endif
 #include "php_h3.h"
 #include <h3/h3api.h>
+#include <float.h>
+#include <math.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if !defined(PHP_WIN32) && defined(__GNUC__)
+#define PHP_H3_SHM_CACHE 1
+#include <sys/mman.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+#if defined(HAVE_PTHREAD_H) && defined(__GNUC__)
+#define PHP_H3_THREADS 1
+#include <pthread.h>
+#endif
 
-/* If you declare any globals in php_h3.h uncomment this:
 ZEND_DECLARE_MODULE_GLOBALS(h3)
-*/
 
 /* True global resources - no need for thread safety here */
 
@@ -36,12 +63,14 @@ ZEND_DECLARE_MODULE_GLOBALS(h3)
 
 /* {{{ PHP_INI
  */
-/* Remove comments and fill if you need to have entries in php.ini
 PHP_INI_BEGIN()
-    STD_PHP_INI_ENTRY("h3.global_value",      "42", PHP_INI_ALL, OnUpdateLong, global_value, zend_h3_globals, h3_globals)
-    STD_PHP_INI_ENTRY("h3.global_string", "foobar", PHP_INI_ALL, OnUpdateString, global_string, zend_h3_globals, h3_globals)
+    STD_PHP_INI_ENTRY("h3.polyfill_cache_size", "0", PHP_INI_ALL, OnUpdateLong, polyfill_cache_size, zend_h3_globals, h3_globals)
+    STD_PHP_INI_ENTRY("h3.shm_cache_size", "0", PHP_INI_SYSTEM, OnUpdateLong, shm_cache_size, zend_h3_globals, h3_globals)
+    STD_PHP_INI_ENTRY("h3.shm_cache_entry_size", "262144", PHP_INI_SYSTEM, OnUpdateLong, shm_cache_entry_size, zend_h3_globals, h3_globals)
+    STD_PHP_INI_ENTRY("h3.polyfill_threads", "1", PHP_INI_ALL, OnUpdateLong, polyfill_threads, zend_h3_globals, h3_globals)
+    STD_PHP_INI_ENTRY("h3.arena_size", "1048576", PHP_INI_SYSTEM, OnUpdateLong, arena_size, zend_h3_globals, h3_globals)
+    STD_PHP_INI_BOOLEAN("h3.stats", "0", PHP_INI_SYSTEM, OnUpdateBool, stats_enabled, zend_h3_globals, h3_globals)
 PHP_INI_END()
-*/
 /* }}} */
 
 /* Remove the following function when you have successfully modified config.m4
@@ -50,1388 +79,7929 @@ PHP_INI_END()
 
 /* Every user-visible function in PHP should document itself in the source */
 
-PHP_FUNCTION(geoToH3)
+/* {{{ H3IndexSet storage
+ */
+// Native set of indexes backed by one growable H3Index buffer. Set functions
+// read it in place and H3_FORMAT_SET results are written straight into it.
+typedef struct _php_h3_index_set
 {
-    zend_long resolution;
-    double lat, lon;
+    H3Index *indexes;
+    size_t count;
+    size_t capacity;
+    zend_object std;
+} php_h3_index_set;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ddl", &lat, &lon, &resolution) == FAILURE)
+typedef struct _php_h3_index_set_iterator
+{
+    zend_object_iterator intern;
+    size_t position;
+    zval current;
+} php_h3_index_set_iterator;
+
+static zend_class_entry *php_h3_index_set_ce;
+static zend_object_handlers php_h3_index_set_handlers;
+
+static inline php_h3_index_set *php_h3_index_set_from_obj(zend_object *obj)
+{
+    return (php_h3_index_set *)((char *)(obj)-XtOffsetOf(php_h3_index_set, std));
+}
+
+#define Z_H3_INDEX_SET_P(zv) php_h3_index_set_from_obj(Z_OBJ_P((zv)))
+
+static void php_h3_index_set_reserve(php_h3_index_set *set, size_t capacity)
+{
+    if (capacity <= set->capacity)
     {
         return;
     }
 
-    GeoCoord location;
-    location.lat = degsToRads(lat);
-    location.lon = degsToRads(lon);
+    size_t grown = set->capacity * 2;
+    if (grown < capacity)
+    {
+        grown = capacity;
+    }
+    if (grown < 8)
+    {
+        grown = 8;
+    }
 
-    H3Index indexed = geoToH3(&location, resolution);
+    set->indexes = (H3Index *)erealloc(set->indexes, grown * sizeof(H3Index));
+    set->capacity = grown;
+}
 
-    RETURN_LONG(indexed);
+static void php_h3_index_set_append(php_h3_index_set *set, const H3Index *indexes, size_t count)
+{
+    php_h3_index_set_reserve(set, set->count + count);
+    memcpy(set->indexes + set->count, indexes, count * sizeof(H3Index));
+    set->count += count;
 }
 
-PHP_FUNCTION(h3ToGeo)
+static zend_object *php_h3_index_set_create(zend_class_entry *ce)
 {
-    zend_long indexed;
+    php_h3_index_set *set = (php_h3_index_set *)ecalloc(1, sizeof(php_h3_index_set) + zend_object_properties_size(ce));
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    zend_object_std_init(&set->std, ce);
+    object_properties_init(&set->std, ce);
+    set->std.handlers = &php_h3_index_set_handlers;
+
+    return &set->std;
+}
+
+static void php_h3_index_set_free(zend_object *obj)
+{
+    php_h3_index_set *set = php_h3_index_set_from_obj(obj);
+
+    if (set->indexes != NULL)
     {
-        return;
+        efree(set->indexes);
     }
 
-    // Get the center coordinates.
-    GeoCoord center;
-    h3ToGeo(indexed, &center);
+    zend_object_std_dtor(&set->std);
+}
 
-    double lat_zval, lon_zval;
-    lat_zval = radsToDegs(center.lat);
-    lon_zval = radsToDegs(center.lon);
+#if PHP_VERSION_ID >= 80000
+static zend_object *php_h3_index_set_clone(zend_object *old_obj)
+{
+#else
+static zend_object *php_h3_index_set_clone(zval *object)
+{
+    zend_object *old_obj = Z_OBJ_P(object);
+#endif
+    zend_object *new_obj = php_h3_index_set_create(old_obj->ce);
+    php_h3_index_set *old_set = php_h3_index_set_from_obj(old_obj);
+    php_h3_index_set *new_set = php_h3_index_set_from_obj(new_obj);
 
-    array_init(return_value);
-    add_assoc_double(return_value, "lat", lat_zval);
-    add_assoc_double(return_value, "lon", lon_zval);
+    zend_objects_clone_members(new_obj, old_obj);
+    php_h3_index_set_append(new_set, old_set->indexes, old_set->count);
+
+    return new_obj;
 }
 
-PHP_FUNCTION(h3ToGeoBoundary)
+static void php_h3_index_set_iterator_dtor(zend_object_iterator *iter)
 {
-    zend_long indexed;
+    zval_ptr_dtor(&iter->data);
+}
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
-    {
-        return;
-    }
+static int php_h3_index_set_iterator_valid(zend_object_iterator *iter)
+{
+    php_h3_index_set_iterator *it = (php_h3_index_set_iterator *)iter;
 
-    // Get the vertices of the H3 index.
-    GeoBoundary boundary;
-    h3ToGeoBoundary(indexed, &boundary);
+    return it->position < Z_H3_INDEX_SET_P(&iter->data)->count ? SUCCESS : FAILURE;
+}
 
-    array_init(return_value);
-    // Indexes can have different number of vertices under some cases,
-    // which is why boundary.numVerts is needed.
-    for (int i = 0; i < boundary.numVerts; i++)
-    {
-        double lat, lon;
+static zval *php_h3_index_set_iterator_current(zend_object_iterator *iter)
+{
+    php_h3_index_set_iterator *it = (php_h3_index_set_iterator *)iter;
 
-        lat = radsToDegs(boundary.verts[i].lat);
-        lon = radsToDegs(boundary.verts[i].lon);
+    ZVAL_LONG(&it->current, Z_H3_INDEX_SET_P(&iter->data)->indexes[it->position]);
+    return &it->current;
+}
 
-        zval lat_lon_arr;
-        array_init(&lat_lon_arr);
-        add_assoc_double(&lat_lon_arr, "lat", lat);
-        add_assoc_double(&lat_lon_arr, "lon", lon);
+static void php_h3_index_set_iterator_key(zend_object_iterator *iter, zval *key)
+{
+    ZVAL_LONG(key, ((php_h3_index_set_iterator *)iter)->position);
+}
 
-        add_index_zval(return_value, i, &lat_lon_arr);
-    }
+static void php_h3_index_set_iterator_next(zend_object_iterator *iter)
+{
+    ((php_h3_index_set_iterator *)iter)->position++;
 }
 
-PHP_FUNCTION(h3GetResolution)
+static void php_h3_index_set_iterator_rewind(zend_object_iterator *iter)
 {
-    zend_long indexed;
+    ((php_h3_index_set_iterator *)iter)->position = 0;
+}
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+static zend_object_iterator_funcs php_h3_index_set_iterator_funcs = {
+    php_h3_index_set_iterator_dtor,
+    php_h3_index_set_iterator_valid,
+    php_h3_index_set_iterator_current,
+    php_h3_index_set_iterator_key,
+    php_h3_index_set_iterator_next,
+    php_h3_index_set_iterator_rewind,
+    NULL};
+
+static zend_object_iterator *php_h3_index_set_get_iterator(zend_class_entry *ce, zval *object, int by_ref)
+{
+    php_h3_index_set_iterator *it;
+
+    if (by_ref)
     {
-        return;
+        zend_throw_error(NULL, "An iterator cannot be used with foreach by reference");
+        return NULL;
     }
 
-    int resolution = h3GetResolution(indexed);
+    it = (php_h3_index_set_iterator *)emalloc(sizeof(php_h3_index_set_iterator));
+    zend_iterator_init(&it->intern);
+    ZVAL_COPY(&it->intern.data, object);
+    it->intern.funcs = &php_h3_index_set_iterator_funcs;
+    it->position = 0;
+    ZVAL_UNDEF(&it->current);
 
-    RETURN_LONG(resolution);
+    return &it->intern;
 }
+/* }}} */
 
-PHP_FUNCTION(h3GetBaseCell)
+/* {{{ H3CellMap storage
+ */
+#define PHP_H3_CELL_MAP_INT 0
+#define PHP_H3_CELL_MAP_FLOAT 1
+
+typedef union _php_h3_cell_value
 {
-    zend_long indexed;
+    zend_long l;
+    double d;
+} php_h3_cell_value;
+
+// Open addressing table from H3Index to an int or float value with linear
+// probing. Empty slots hold key 0, which is never a valid cell. The capacity
+// is a power of two kept at most 3/4 full, and removal shifts the following
+// entries back instead of leaving tombstones.
+typedef struct _php_h3_cell_map
+{
+    H3Index *keys;
+    php_h3_cell_value *values;
+    size_t capacity;
+    size_t count;
+    int type;
+    zend_object std;
+} php_h3_cell_map;
+
+typedef struct _php_h3_cell_map_iterator
+{
+    zend_object_iterator intern;
+    size_t position;
+    zval current;
+} php_h3_cell_map_iterator;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
-    {
-        return;
-    }
+static zend_class_entry *php_h3_cell_map_ce;
+static zend_object_handlers php_h3_cell_map_handlers;
 
-    int base_cell = h3GetBaseCell(indexed);
+static inline php_h3_cell_map *php_h3_cell_map_from_obj(zend_object *obj)
+{
+    return (php_h3_cell_map *)((char *)(obj)-XtOffsetOf(php_h3_cell_map, std));
+}
 
-    RETURN_LONG(base_cell);
+#define Z_H3_CELL_MAP_P(zv) php_h3_cell_map_from_obj(Z_OBJ_P((zv)))
+
+// Cells of one area share their high bits and end in runs of unused 7
+// digits, so the low bits alone collide badly. The murmur3 finalizer spreads
+// every bit of the index over the slot number.
+static inline size_t php_h3_cell_hash(H3Index cell)
+{
+    cell ^= cell >> 33;
+    cell *= 0xff51afd7ed558ccdULL;
+    cell ^= cell >> 33;
+    cell *= 0xc4ceb9fe1a85ec53ULL;
+    cell ^= cell >> 33;
+
+    return (size_t)cell;
 }
 
-PHP_FUNCTION(stringToH3)
+// Returns the slot holding cell, or the empty slot where it belongs.
+static size_t php_h3_cell_map_slot(const php_h3_cell_map *map, H3Index cell)
 {
-    char *str;
-    size_t str_len;
+    size_t mask = map->capacity - 1;
+    size_t slot = php_h3_cell_hash(cell) & mask;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "s", &str, &str_len) == FAILURE)
+    while (map->keys[slot] != 0 && map->keys[slot] != cell)
     {
-        return;
+        slot = (slot + 1) & mask;
     }
 
-    H3Index indexed = stringToH3(str);
-
-    RETURN_LONG(indexed);
+    return slot;
 }
 
-PHP_FUNCTION(h3ToString)
+static void php_h3_cell_map_rehash(php_h3_cell_map *map, size_t capacity)
 {
-    zend_long indexed;
-    char str[17] = "";
+    H3Index *keys = map->keys;
+    php_h3_cell_value *values = map->values;
+    size_t old_capacity = map->capacity;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    map->keys = (H3Index *)ecalloc(capacity, sizeof(H3Index));
+    map->values = (php_h3_cell_value *)ecalloc(capacity, sizeof(php_h3_cell_value));
+    map->capacity = capacity;
+
+    for (size_t i = 0; i < old_capacity; i++)
     {
-        return;
+        if (keys[i] != 0)
+        {
+            size_t slot = php_h3_cell_map_slot(map, keys[i]);
+            map->keys[slot] = keys[i];
+            map->values[slot] = values[i];
+        }
     }
 
-    h3ToString(indexed, str, 17);
-
-    RETURN_STRINGL(str, 17);
+    if (keys != NULL)
+    {
+        efree(keys);
+        efree(values);
+    }
 }
 
-PHP_FUNCTION(h3IsValid)
+static php_h3_cell_value *php_h3_cell_map_find(const php_h3_cell_map *map, H3Index cell)
 {
-    zend_long indexed;
+    size_t slot;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    if (map->count == 0 || cell == 0)
     {
-        return;
+        return NULL;
     }
 
-    if (h3IsValid(indexed) == 0)
+    slot = php_h3_cell_map_slot(map, cell);
+
+    return map->keys[slot] == cell ? &map->values[slot] : NULL;
+}
+
+// Returns the value slot of cell, inserting a zero value first if needed.
+static php_h3_cell_value *php_h3_cell_map_upsert(php_h3_cell_map *map, H3Index cell)
+{
+    size_t slot;
+
+    if ((map->count + 1) * 4 > map->capacity * 3)
     {
-        RETURN_FALSE;
+        php_h3_cell_map_rehash(map, map->capacity < 16 ? 16 : map->capacity * 2);
     }
-    else
+
+    slot = php_h3_cell_map_slot(map, cell);
+    if (map->keys[slot] == 0)
     {
-        RETURN_TRUE;
+        map->keys[slot] = cell;
+        if (map->type == PHP_H3_CELL_MAP_FLOAT)
+        {
+            map->values[slot].d = 0;
+        }
+        else
+        {
+            map->values[slot].l = 0;
+        }
+        map->count++;
     }
+
+    return &map->values[slot];
 }
 
-PHP_FUNCTION(h3IsResClassIII)
+static int php_h3_cell_map_remove(php_h3_cell_map *map, H3Index cell)
 {
-    zend_long indexed;
+    size_t mask, hole, next;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    if (map->count == 0 || cell == 0)
     {
-        return;
+        return FAILURE;
     }
 
-    if (h3IsResClassIII(indexed) == 0)
+    mask = map->capacity - 1;
+    hole = php_h3_cell_map_slot(map, cell);
+    if (map->keys[hole] == 0)
     {
-        RETURN_FALSE;
+        return FAILURE;
     }
-    else
+
+    // move back every following entry of the run whose home slot is not
+    // between the hole and its current position
+    for (next = (hole + 1) & mask; map->keys[next] != 0; next = (next + 1) & mask)
     {
-        RETURN_TRUE;
+        size_t home = php_h3_cell_hash(map->keys[next]) & mask;
+
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            map->keys[hole] = map->keys[next];
+            map->values[hole] = map->values[next];
+            hole = next;
+        }
     }
+
+    map->keys[hole] = 0;
+    map->count--;
+
+    return SUCCESS;
 }
 
-PHP_FUNCTION(h3IsPentagon)
+static php_h3_cell_value *php_h3_cell_map_add(php_h3_cell_map *map, H3Index cell, zend_long by_long, double by_double)
 {
-    zend_long indexed;
+    php_h3_cell_value *value = php_h3_cell_map_upsert(map, cell);
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    if (map->type == PHP_H3_CELL_MAP_FLOAT)
     {
-        return;
+        value->d += by_double;
+    }
+    else
+    {
+        value->l += by_long;
     }
 
-    if (h3IsPentagon(indexed) == 0)
+    return value;
+}
+
+static void php_h3_cell_map_value_zval(const php_h3_cell_map *map, const php_h3_cell_value *value, zval *out)
+{
+    if (map->type == PHP_H3_CELL_MAP_FLOAT)
     {
-        RETURN_FALSE;
+        ZVAL_DOUBLE(out, value->d);
     }
     else
     {
-        RETURN_TRUE;
+        ZVAL_LONG(out, value->l);
     }
 }
 
-PHP_FUNCTION(h3GetFaces)
+static zend_object *php_h3_cell_map_create(zend_class_entry *ce)
 {
-    zend_long indexed;
-    int arr_count;
+    php_h3_cell_map *map = (php_h3_cell_map *)ecalloc(1, sizeof(php_h3_cell_map) + zend_object_properties_size(ce));
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    zend_object_std_init(&map->std, ce);
+    object_properties_init(&map->std, ce);
+    map->std.handlers = &php_h3_cell_map_handlers;
+
+    return &map->std;
+}
+
+static void php_h3_cell_map_free(zend_object *obj)
+{
+    php_h3_cell_map *map = php_h3_cell_map_from_obj(obj);
+
+    if (map->keys != NULL)
     {
-        return;
+        efree(map->keys);
+        efree(map->values);
     }
 
-    arr_count = maxFaceCount(indexed);
-    int *outs = (int *)calloc(arr_count, sizeof(int));
+    zend_object_std_dtor(&map->std);
+}
 
-    h3GetFaces(indexed, outs);
+#if PHP_VERSION_ID >= 80000
+static zend_object *php_h3_cell_map_clone(zend_object *old_obj)
+{
+#else
+static zend_object *php_h3_cell_map_clone(zval *object)
+{
+    zend_object *old_obj = Z_OBJ_P(object);
+#endif
+    zend_object *new_obj = php_h3_cell_map_create(old_obj->ce);
+    php_h3_cell_map *old_map = php_h3_cell_map_from_obj(old_obj);
+    php_h3_cell_map *new_map = php_h3_cell_map_from_obj(new_obj);
 
-    array_init(return_value);
+    zend_objects_clone_members(new_obj, old_obj);
 
-    for (int i = 0; i < arr_count; i++)
+    new_map->type = old_map->type;
+    new_map->count = old_map->count;
+    new_map->capacity = old_map->capacity;
+    if (old_map->capacity > 0)
     {
-        add_index_long(return_value, i, outs[i]);
+        new_map->keys = (H3Index *)emalloc(old_map->capacity * sizeof(H3Index));
+        new_map->values = (php_h3_cell_value *)emalloc(old_map->capacity * sizeof(php_h3_cell_value));
+        memcpy(new_map->keys, old_map->keys, old_map->capacity * sizeof(H3Index));
+        memcpy(new_map->values, old_map->values, old_map->capacity * sizeof(php_h3_cell_value));
     }
-    free(outs);
+
+    return new_obj;
 }
 
-PHP_FUNCTION(maxFaceCount)
+static void php_h3_cell_map_iterator_dtor(zend_object_iterator *iter)
 {
-    zend_long indexed;
-    int count;
+    zval_ptr_dtor(&iter->data);
+}
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+// Moves to the first occupied slot at or after the current position.
+static void php_h3_cell_map_iterator_skip(php_h3_cell_map_iterator *it)
+{
+    php_h3_cell_map *map = Z_H3_CELL_MAP_P(&it->intern.data);
+
+    while (it->position < map->capacity && map->keys[it->position] == 0)
     {
-        return;
+        it->position++;
     }
+}
 
-    count = maxFaceCount(indexed);
+static int php_h3_cell_map_iterator_valid(zend_object_iterator *iter)
+{
+    php_h3_cell_map_iterator *it = (php_h3_cell_map_iterator *)iter;
 
-    RETURN_LONG(count);
+    return it->position < Z_H3_CELL_MAP_P(&iter->data)->capacity ? SUCCESS : FAILURE;
 }
 
-PHP_FUNCTION(kRing)
+static zval *php_h3_cell_map_iterator_current(zend_object_iterator *iter)
 {
-    zend_long indexed, k;
+    php_h3_cell_map_iterator *it = (php_h3_cell_map_iterator *)iter;
+    php_h3_cell_map *map = Z_H3_CELL_MAP_P(&iter->data);
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &k) == FAILURE)
-    {
-        return;
-    }
+    php_h3_cell_map_value_zval(map, &map->values[it->position], &it->current);
+    return &it->current;
+}
 
-    int arr_count = maxKringSize(k);
-    H3Index *outs = (H3Index *)calloc(arr_count, sizeof(H3Index));
+static void php_h3_cell_map_iterator_key(zend_object_iterator *iter, zval *key)
+{
+    php_h3_cell_map_iterator *it = (php_h3_cell_map_iterator *)iter;
 
-    kRing(indexed, k, outs);
+    ZVAL_LONG(key, Z_H3_CELL_MAP_P(&iter->data)->keys[it->position]);
+}
 
-    array_init(return_value);
+static void php_h3_cell_map_iterator_next(zend_object_iterator *iter)
+{
+    php_h3_cell_map_iterator *it = (php_h3_cell_map_iterator *)iter;
 
-    for (int i = 0; i < arr_count; i++)
+    it->position++;
+    php_h3_cell_map_iterator_skip(it);
+}
+
+static void php_h3_cell_map_iterator_rewind(zend_object_iterator *iter)
+{
+    php_h3_cell_map_iterator *it = (php_h3_cell_map_iterator *)iter;
+
+    it->position = 0;
+    php_h3_cell_map_iterator_skip(it);
+}
+
+static zend_object_iterator_funcs php_h3_cell_map_iterator_funcs = {
+    php_h3_cell_map_iterator_dtor,
+    php_h3_cell_map_iterator_valid,
+    php_h3_cell_map_iterator_current,
+    php_h3_cell_map_iterator_key,
+    php_h3_cell_map_iterator_next,
+    php_h3_cell_map_iterator_rewind,
+    NULL};
+
+static zend_object_iterator *php_h3_cell_map_get_iterator(zend_class_entry *ce, zval *object, int by_ref)
+{
+    php_h3_cell_map_iterator *it;
+
+    if (by_ref)
     {
-        add_index_long(return_value, i, outs[i]);
+        zend_throw_error(NULL, "An iterator cannot be used with foreach by reference");
+        return NULL;
     }
 
-    free(outs);
+    it = (php_h3_cell_map_iterator *)emalloc(sizeof(php_h3_cell_map_iterator));
+    zend_iterator_init(&it->intern);
+    ZVAL_COPY(&it->intern.data, object);
+    it->intern.funcs = &php_h3_cell_map_iterator_funcs;
+    it->position = 0;
+    ZVAL_UNDEF(&it->current);
+
+    return &it->intern;
 }
+/* }}} */
 
-PHP_FUNCTION(maxKringSize)
+/* {{{ H3PointIndex storage
+ */
+typedef struct _php_h3_point_hit
+{
+    double km;
+    uint32_t id;
+} php_h3_point_hit;
+
+// Points bucketed by cell at one resolution: cells holds the distinct cells
+// in ascending order and the ids of the points inside cells[i] are
+// ids[offsets[i]] up to ids[offsets[i + 1]]. Query scratch space lives in the
+// object so that repeated queries do not allocate. Searches walk rings up
+// to max_k, the last one whose disk has no more cells than there are
+// buckets; near pentagons the disk of max_k is computed once into disk.
+typedef struct _php_h3_point_index
+{
+    int res;
+    int max_k;
+    size_t point_count;
+    size_t bucket_count;
+    H3Index *cells;
+    uint32_t *offsets;
+    uint32_t *ids;
+    GeoCoord *coords;
+    H3Index *ring;
+    H3Index *disk;
+    int *disk_distances;
+    H3Index disk_origin;
+    php_h3_point_hit *hits;
+    size_t hit_capacity;
+    zend_object std;
+} php_h3_point_index;
+
+typedef struct _php_h3_point_entry
+{
+    H3Index cell;
+    uint32_t id;
+} php_h3_point_entry;
+
+static zend_class_entry *php_h3_point_index_ce;
+static zend_object_handlers php_h3_point_index_handlers;
+
+static inline php_h3_point_index *php_h3_point_index_from_obj(zend_object *obj)
+{
+    return (php_h3_point_index *)((char *)(obj)-XtOffsetOf(php_h3_point_index, std));
+}
+
+#define Z_H3_POINT_INDEX_P(zv) php_h3_point_index_from_obj(Z_OBJ_P((zv)))
+
+static zend_object *php_h3_point_index_create(zend_class_entry *ce)
+{
+    php_h3_point_index *index = (php_h3_point_index *)ecalloc(1, sizeof(php_h3_point_index) + zend_object_properties_size(ce));
+
+    zend_object_std_init(&index->std, ce);
+    object_properties_init(&index->std, ce);
+    index->std.handlers = &php_h3_point_index_handlers;
+
+    return &index->std;
+}
+
+static void php_h3_point_index_free(zend_object *obj)
+{
+    php_h3_point_index *index = php_h3_point_index_from_obj(obj);
+
+    // build() allocates these together
+    if (index->cells != NULL)
+    {
+        efree(index->cells);
+        efree(index->offsets);
+        efree(index->ids);
+        efree(index->coords);
+        efree(index->ring);
+    }
+    if (index->disk != NULL)
+    {
+        efree(index->disk);
+        efree(index->disk_distances);
+    }
+    if (index->hits != NULL)
+    {
+        efree(index->hits);
+    }
+
+    zend_object_std_dtor(&index->std);
+}
+
+static int php_h3_point_entry_compare(const void *a, const void *b)
+{
+    const php_h3_point_entry *ea = (const php_h3_point_entry *)a;
+    const php_h3_point_entry *eb = (const php_h3_point_entry *)b;
+
+    if (ea->cell != eb->cell)
+    {
+        return ea->cell < eb->cell ? -1 : 1;
+    }
+    return ea->id < eb->id ? -1 : (ea->id > eb->id ? 1 : 0);
+}
+
+static int php_h3_point_hit_compare(const void *a, const void *b)
+{
+    const php_h3_point_hit *ha = (const php_h3_point_hit *)a;
+    const php_h3_point_hit *hb = (const php_h3_point_hit *)b;
+
+    if (ha->km != hb->km)
+    {
+        return ha->km < hb->km ? -1 : 1;
+    }
+    return ha->id < hb->id ? -1 : (ha->id > hb->id ? 1 : 0);
+}
+
+// Buckets coords (interleaved lat/lon in radians, copied) by cell.
+static void php_h3_point_index_build(php_h3_point_index *index, const double *coords, size_t count, int res)
+{
+    php_h3_point_entry *entries = (php_h3_point_entry *)emalloc((count + 1) * sizeof(php_h3_point_entry));
+    size_t valid = 0;
+
+    index->res = res;
+    index->point_count = count;
+    index->coords = (GeoCoord *)emalloc((count + 1) * sizeof(GeoCoord));
+    memcpy(index->coords, coords, count * sizeof(GeoCoord));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        H3Index cell = geoToH3(&index->coords[i], res);
+
+        if (cell != 0)
+        {
+            entries[valid].cell = cell;
+            entries[valid].id = (uint32_t)i;
+            valid++;
+        }
+    }
+
+    qsort(entries, valid, sizeof(php_h3_point_entry), php_h3_point_entry_compare);
+
+    index->cells = (H3Index *)emalloc((valid + 1) * sizeof(H3Index));
+    index->offsets = (uint32_t *)emalloc((valid + 2) * sizeof(uint32_t));
+    index->ids = (uint32_t *)emalloc((valid + 1) * sizeof(uint32_t));
+
+    for (size_t i = 0; i < valid; i++)
+    {
+        if (i == 0 || entries[i].cell != entries[i - 1].cell)
+        {
+            index->cells[index->bucket_count] = entries[i].cell;
+            index->offsets[index->bucket_count] = (uint32_t)i;
+            index->bucket_count++;
+        }
+        index->ids[i] = entries[i].id;
+    }
+    index->offsets[index->bucket_count] = (uint32_t)valid;
+
+    efree(entries);
+
+    while (3 * (size_t)(index->max_k + 1) * (index->max_k + 2) + 1 <= index->bucket_count)
+    {
+        index->max_k++;
+    }
+    index->ring = (H3Index *)emalloc(MAX(6 * (size_t)index->max_k, 1) * sizeof(H3Index));
+}
+
+// Returns the bucket of a cell, or bucket_count when no point falls inside it.
+static size_t php_h3_point_index_bucket(const php_h3_point_index *index, H3Index cell)
+{
+    size_t low = 0, high = index->bucket_count;
+
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+
+        if (index->cells[mid] < cell)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low < index->bucket_count && index->cells[low] == cell ? low : index->bucket_count;
+}
+
+// Fills index->ring with the cells exactly k <= max_k steps from origin and
+// returns their number. Next to pentagons hexRing() gives up; the disk of
+// max_k around origin is then computed once and filtered for every ring.
+static size_t php_h3_point_index_ring(php_h3_point_index *index, H3Index origin, int k)
+{
+    size_t size = k == 0 ? 1 : 6 * (size_t)k;
+    size_t disk_size = 3 * (size_t)index->max_k * (index->max_k + 1) + 1;
+    size_t count = 0;
+
+    if (index->disk_origin != origin)
+    {
+        if (hexRing(origin, k, index->ring) == 0)
+        {
+            return size;
+        }
+
+        if (index->disk == NULL)
+        {
+            index->disk = (H3Index *)emalloc(disk_size * sizeof(H3Index));
+            index->disk_distances = (int *)emalloc(disk_size * sizeof(int));
+        }
+        memset(index->disk, 0, disk_size * sizeof(H3Index));
+        kRingDistances(origin, index->max_k, index->disk, index->disk_distances);
+        index->disk_origin = origin;
+    }
+
+    for (size_t i = 0; i < disk_size && count < size; i++)
+    {
+        if (index->disk[i] != 0 && index->disk_distances[i] == k)
+        {
+            index->ring[count++] = index->disk[i];
+        }
+    }
+
+    return count;
+}
+
+// Lower bound on the distance from origin to any point outside the disk
+// whose outer ring is cells. A way out crosses an edge a-b of one of them,
+// and by the triangle inequality no point of that edge is closer than
+// (|oa| + |ob| - |ab|) / 2. Cell edges are great-circle arcs between the
+// boundary vertices, which include the extra ones where an edge crosses an
+// icosahedron face, so the bound is exact geometry with no safety factor.
+static double php_h3_point_index_reach(const H3Index *cells, size_t count, const GeoCoord *origin)
+{
+    double reach = INFINITY;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        GeoBoundary boundary;
+
+        h3ToGeoBoundary(cells[i], &boundary);
+        if (boundary.numVerts == 0)
+        {
+            continue;
+        }
+
+        double first = pointDistKm(origin, &boundary.verts[0]), from = first;
+
+        for (int v = 0; v < boundary.numVerts; v++)
+        {
+            int next = v + 1 == boundary.numVerts ? 0 : v + 1;
+            double to = next == 0 ? first : pointDistKm(origin, &boundary.verts[next]);
+            double edge = pointDistKm(&boundary.verts[v], &boundary.verts[next]);
+
+            reach = MIN(reach, (from + to - edge) / 2);
+            from = to;
+        }
+    }
+
+    return reach;
+}
+
+// One query in progress: with k == 0 every point within max_km is kept,
+// otherwise index->hits is a max-heap of the k closest so far.
+typedef struct _php_h3_point_query
+{
+    double max_km;
+    size_t k;
+    size_t count;
+} php_h3_point_query;
+
+static void php_h3_point_heap_sift_down(php_h3_point_hit *hits, size_t count, size_t i)
+{
+    for (;;)
+    {
+        size_t largest = i, left = 2 * i + 1, right = 2 * i + 2;
+
+        if (left < count && php_h3_point_hit_compare(&hits[left], &hits[largest]) > 0)
+        {
+            largest = left;
+        }
+        if (right < count && php_h3_point_hit_compare(&hits[right], &hits[largest]) > 0)
+        {
+            largest = right;
+        }
+        if (largest == i)
+        {
+            return;
+        }
+
+        php_h3_point_hit tmp = hits[i];
+        hits[i] = hits[largest];
+        hits[largest] = tmp;
+        i = largest;
+    }
+}
+
+static void php_h3_point_index_offer(php_h3_point_index *index, php_h3_point_query *query, uint32_t id, double km)
+{
+    php_h3_point_hit hit = {km, id};
+
+    if (km > query->max_km)
+    {
+        return;
+    }
+
+    if (query->k == 0 || query->count < query->k)
+    {
+        if (index->hit_capacity == query->count)
+        {
+            index->hit_capacity = index->hit_capacity < 16 ? 16 : index->hit_capacity * 2;
+            index->hits = (php_h3_point_hit *)erealloc(index->hits, index->hit_capacity * sizeof(php_h3_point_hit));
+        }
+
+        size_t i = query->count++;
+        index->hits[i] = hit;
+
+        // sift up while filling the heap
+        while (query->k != 0 && i > 0 && php_h3_point_hit_compare(&index->hits[(i - 1) / 2], &index->hits[i]) < 0)
+        {
+            php_h3_point_hit tmp = index->hits[i];
+            index->hits[i] = index->hits[(i - 1) / 2];
+            index->hits[(i - 1) / 2] = tmp;
+            i = (i - 1) / 2;
+        }
+    }
+    else if (php_h3_point_hit_compare(&hit, &index->hits[0]) < 0)
+    {
+        index->hits[0] = hit;
+        php_h3_point_heap_sift_down(index->hits, query->count, 0);
+    }
+}
+
+static void php_h3_point_index_visit_bucket(php_h3_point_index *index, php_h3_point_query *query, size_t bucket, const GeoCoord *origin)
+{
+    for (uint32_t i = index->offsets[bucket]; i < index->offsets[bucket + 1]; i++)
+    {
+        uint32_t id = index->ids[i];
+
+        php_h3_point_index_offer(index, query, id, pointDistKm(origin, &index->coords[id]));
+    }
+}
+
+// Visits the buckets ring by ring around origin until no closer point can
+// be left, and leaves the hits sorted by distance. Once the rings would
+// cover more cells than there are buckets it falls back to a single scan
+// of all buckets, so no query costs more than one pass over the index.
+static void php_h3_point_index_search(php_h3_point_index *index, php_h3_point_query *query, const GeoCoord *origin)
+{
+    H3Index origin_cell = geoToH3(origin, index->res);
+    int done = 0;
+
+    query->count = 0;
+
+    if (origin_cell != 0)
+    {
+        for (int k = 0; k <= index->max_k; k++)
+        {
+            size_t count = php_h3_point_index_ring(index, origin_cell, k);
+            for (size_t i = 0; i < count; i++)
+            {
+                size_t bucket = php_h3_point_index_bucket(index, index->ring[i]);
+
+                if (bucket < index->bucket_count)
+                {
+                    php_h3_point_index_visit_bucket(index, query, bucket, origin);
+                }
+            }
+
+            // the bound is only worth its cost once it could end the search
+            int full = query->k != 0 && query->count == query->k;
+
+            if (!full && query->max_km == INFINITY)
+            {
+                continue;
+            }
+
+            // every point not seen yet is at least this far away
+            double min_km = php_h3_point_index_reach(index->ring, count, origin);
+
+            if (min_km > query->max_km || (full && index->hits[0].km <= min_km))
+            {
+                done = 1;
+                break;
+            }
+        }
+    }
+
+    if (!done)
+    {
+        query->count = 0;
+        for (size_t bucket = 0; bucket < index->bucket_count; bucket++)
+        {
+            php_h3_point_index_visit_bucket(index, query, bucket, origin);
+        }
+    }
+
+    qsort(index->hits, query->count, sizeof(php_h3_point_hit), php_h3_point_hit_compare);
+}
+/* }}} */
+
+/* {{{ H3EntityIndex storage
+ */
+// Current cell of every entity plus the members of every occupied cell, all
+// updatable in constant time. Entities live densely in records and the
+// members of a cell densely in its bucket; both are kept dense by moving the
+// last element into the hole on removal, with each record remembering its
+// position in its bucket. Records find their bucket through their cell, so
+// moving a bucket only touches the cell table. Ids map to records through a HashTable, cells to
+// buckets through the H3CellMap table (only its table part is used).
+typedef struct _php_h3_entity
+{
+    zend_long id;
+    H3Index cell;
+    uint32_t position;
+} php_h3_entity;
+
+typedef struct _php_h3_entity_bucket
+{
+    H3Index cell;
+    uint32_t *members;
+    uint32_t count;
+    uint32_t capacity;
+} php_h3_entity_bucket;
+
+typedef struct _php_h3_entity_index
+{
+    int res;
+    HashTable ids;
+    php_h3_cell_map cells;
+    php_h3_entity *records;
+    size_t record_count;
+    size_t record_capacity;
+    php_h3_entity_bucket *buckets;
+    size_t bucket_count;
+    size_t bucket_capacity;
+    zend_object std;
+} php_h3_entity_index;
+
+static zend_class_entry *php_h3_entity_index_ce;
+static zend_object_handlers php_h3_entity_index_handlers;
+
+static inline php_h3_entity_index *php_h3_entity_index_from_obj(zend_object *obj)
+{
+    return (php_h3_entity_index *)((char *)(obj)-XtOffsetOf(php_h3_entity_index, std));
+}
+
+#define Z_H3_ENTITY_INDEX_P(zv) php_h3_entity_index_from_obj(Z_OBJ_P((zv)))
+
+static zend_object *php_h3_entity_index_create(zend_class_entry *ce)
+{
+    php_h3_entity_index *index = (php_h3_entity_index *)ecalloc(1, sizeof(php_h3_entity_index) + zend_object_properties_size(ce));
+
+    zend_object_std_init(&index->std, ce);
+    object_properties_init(&index->std, ce);
+    index->std.handlers = &php_h3_entity_index_handlers;
+    index->cells.type = PHP_H3_CELL_MAP_INT;
+    zend_hash_init(&index->ids, 8, NULL, NULL, 0);
+
+    return &index->std;
+}
+
+static void php_h3_entity_index_free(zend_object *obj)
+{
+    php_h3_entity_index *index = php_h3_entity_index_from_obj(obj);
+
+    for (size_t i = 0; i < index->bucket_count; i++)
+    {
+        efree(index->buckets[i].members);
+    }
+    if (index->buckets != NULL)
+    {
+        efree(index->buckets);
+    }
+    if (index->records != NULL)
+    {
+        efree(index->records);
+    }
+    if (index->cells.keys != NULL)
+    {
+        efree(index->cells.keys);
+        efree(index->cells.values);
+    }
+    zend_hash_destroy(&index->ids);
+
+    zend_object_std_dtor(&index->std);
+}
+
+// Returns the bucket of cell, or bucket_count when nobody is inside it.
+static size_t php_h3_entity_index_bucket(const php_h3_entity_index *index, H3Index cell)
+{
+    php_h3_cell_value *value = php_h3_cell_map_find(&index->cells, cell);
+
+    return value != NULL ? (size_t)value->l : index->bucket_count;
+}
+
+static void php_h3_entity_index_join(php_h3_entity_index *index, uint32_t record, H3Index cell)
+{
+    php_h3_entity *entity = &index->records[record];
+    size_t b = php_h3_entity_index_bucket(index, cell);
+    php_h3_entity_bucket *bucket;
+
+    if (b == index->bucket_count)
+    {
+        if (index->bucket_count == index->bucket_capacity)
+        {
+            index->bucket_capacity = index->bucket_capacity < 16 ? 16 : index->bucket_capacity * 2;
+            index->buckets = (php_h3_entity_bucket *)erealloc(index->buckets, index->bucket_capacity * sizeof(php_h3_entity_bucket));
+        }
+
+        bucket = &index->buckets[index->bucket_count];
+        bucket->cell = cell;
+        bucket->count = 0;
+        bucket->capacity = 4;
+        bucket->members = (uint32_t *)emalloc(bucket->capacity * sizeof(uint32_t));
+        php_h3_cell_map_upsert(&index->cells, cell)->l = (zend_long)index->bucket_count;
+        index->bucket_count++;
+    }
+    else
+    {
+        bucket = &index->buckets[b];
+    }
+
+    if (bucket->count == bucket->capacity)
+    {
+        bucket->capacity *= 2;
+        bucket->members = (uint32_t *)erealloc(bucket->members, bucket->capacity * sizeof(uint32_t));
+    }
+
+    entity->cell = cell;
+    entity->position = bucket->count;
+    bucket->members[bucket->count++] = record;
+}
+
+static void php_h3_entity_index_leave(php_h3_entity_index *index, uint32_t record)
+{
+    php_h3_entity *entity = &index->records[record];
+    size_t b = php_h3_entity_index_bucket(index, entity->cell);
+    php_h3_entity_bucket *bucket = &index->buckets[b];
+    uint32_t last = bucket->members[--bucket->count];
+
+    bucket->members[entity->position] = last;
+    index->records[last].position = entity->position;
+
+    if (bucket->count > 0)
+    {
+        return;
+    }
+
+    // the cell is empty now, move the last bucket into its place
+    php_h3_cell_map_remove(&index->cells, bucket->cell);
+    efree(bucket->members);
+
+    if (b != --index->bucket_count)
+    {
+        index->buckets[b] = index->buckets[index->bucket_count];
+        php_h3_cell_map_find(&index->cells, index->buckets[b].cell)->l = (zend_long)b;
+    }
+}
+
+// Moves entity id to cell, adding it first if needed.
+static void php_h3_entity_index_set(php_h3_entity_index *index, zend_long id, H3Index cell)
+{
+    zval *found = zend_hash_index_find(&index->ids, id);
+    uint32_t record;
+
+    if (found != NULL)
+    {
+        record = (uint32_t)Z_LVAL_P(found);
+        if (index->records[record].cell == cell)
+        {
+            return;
+        }
+        php_h3_entity_index_leave(index, record);
+    }
+    else
+    {
+        zval value;
+
+        if (index->record_count == index->record_capacity)
+        {
+            index->record_capacity = index->record_capacity < 16 ? 16 : index->record_capacity * 2;
+            index->records = (php_h3_entity *)erealloc(index->records, index->record_capacity * sizeof(php_h3_entity));
+        }
+
+        record = (uint32_t)index->record_count++;
+        index->records[record].id = id;
+        ZVAL_LONG(&value, record);
+        zend_hash_index_add_new(&index->ids, id, &value);
+    }
+
+    php_h3_entity_index_join(index, record, cell);
+}
+
+static int php_h3_entity_index_remove(php_h3_entity_index *index, zend_long id)
+{
+    zval *found = zend_hash_index_find(&index->ids, id);
+    uint32_t record, last;
+
+    if (found == NULL)
+    {
+        return FAILURE;
+    }
+
+    record = (uint32_t)Z_LVAL_P(found);
+    php_h3_entity_index_leave(index, record);
+    zend_hash_index_del(&index->ids, id);
+
+    // keep the records dense, the last one takes the freed place
+    last = (uint32_t)--index->record_count;
+    if (record != last)
+    {
+        php_h3_entity *moved = &index->records[last];
+        size_t b = php_h3_entity_index_bucket(index, moved->cell);
+
+        index->records[record] = *moved;
+        index->buckets[b].members[moved->position] = record;
+        ZVAL_LONG(zend_hash_index_find(&index->ids, moved->id), record);
+    }
+
+    return SUCCESS;
+}
+/* }}} */
+
+/* {{{ scratch arena
+ */
+// Per-thread bump allocator for the scratch buffers of one call. It is
+// allocated once at h3.arena_size bytes. Every chunk starts with a header
+// holding the previous top, so callers free their buffers in reverse order
+// and the space comes back immediately. Requests that do not fit are
+// malloc()ed and kept on a list. The arena is only reset in RSHUTDOWN,
+// where whatever an error path left behind is reclaimed; resetting while a
+// chunk is live would hand its memory out twice.
+#define PHP_H3_ARENA_HEADER 16
+
+typedef struct _php_h3_arena_block
+{
+    struct _php_h3_arena_block *prev;
+    struct _php_h3_arena_block *next;
+} php_h3_arena_block;
+
+static void php_h3_arena_reset(void)
+{
+    php_h3_arena_block *block = (php_h3_arena_block *)H3_G(arena_overflow);
+
+    while (block != NULL)
+    {
+        php_h3_arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    H3_G(arena_overflow) = NULL;
+    H3_G(arena_used) = 0;
+    H3_G(arena_top) = 0;
+}
+
+static void *php_h3_arena_alloc(size_t bytes, int zero)
+{
+    size_t size;
+    void *ptr;
+
+    if (bytes > SIZE_MAX - 2 * PHP_H3_ARENA_HEADER)
+    {
+        zend_error_noreturn(E_ERROR, "Possible integer overflow in scratch allocation (%zu bytes)", bytes);
+    }
+    size = PHP_H3_ARENA_HEADER + ((bytes + PHP_H3_ARENA_HEADER - 1) & ~(size_t)(PHP_H3_ARENA_HEADER - 1));
+
+    if (H3_G(arena) == NULL && H3_G(arena_size) > 0)
+    {
+        H3_G(arena) = (char *)pemalloc(H3_G(arena_size), 1);
+    }
+
+    if (H3_G(arena) != NULL && size <= (size_t)H3_G(arena_size) - H3_G(arena_used))
+    {
+        char *chunk = H3_G(arena) + H3_G(arena_used);
+
+        *(size_t *)chunk = H3_G(arena_top);
+        H3_G(arena_top) = H3_G(arena_used);
+        H3_G(arena_used) += size;
+        if (H3_G(arena_used) > H3_G(arena_high_water))
+        {
+            H3_G(arena_high_water) = H3_G(arena_used);
+        }
+
+        ptr = chunk + PHP_H3_ARENA_HEADER;
+        if (zero)
+        {
+            memset(ptr, 0, bytes);
+        }
+        return ptr;
+    }
+
+    php_h3_arena_block *block = (php_h3_arena_block *)(zero ? calloc(1, size) : malloc(size));
+
+    if (block == NULL)
+    {
+        zend_error_noreturn(E_ERROR, "Out of memory (tried to allocate %zu bytes of scratch space)", size);
+    }
+
+    block->prev = NULL;
+    block->next = (php_h3_arena_block *)H3_G(arena_overflow);
+    if (block->next != NULL)
+    {
+        block->next->prev = block;
+    }
+    H3_G(arena_overflow) = block;
+    H3_G(arena_fallbacks)++;
+
+    return (char *)block + PHP_H3_ARENA_HEADER;
+}
+
+static void php_h3_arena_free(void *ptr)
+{
+    char *chunk = (char *)ptr - PHP_H3_ARENA_HEADER;
+
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    if (H3_G(arena) != NULL && chunk >= H3_G(arena) && chunk < H3_G(arena) + H3_G(arena_size))
+    {
+        // only the newest chunk can be given back, the rest waits for a reset
+        if ((size_t)(chunk - H3_G(arena)) == H3_G(arena_top))
+        {
+            H3_G(arena_used) = H3_G(arena_top);
+            H3_G(arena_top) = *(size_t *)chunk;
+        }
+        return;
+    }
+
+    php_h3_arena_block *block = (php_h3_arena_block *)chunk;
+
+    if (block->prev != NULL)
+    {
+        block->prev->next = block->next;
+    }
+    else
+    {
+        H3_G(arena_overflow) = block->next;
+    }
+    if (block->next != NULL)
+    {
+        block->next->prev = block->prev;
+    }
+    free(block);
+}
+/* }}} */
+
+/* {{{ index set input/output helpers
+ */
+// Output buffer for set-returning functions. In H3_FORMAT_PACKED mode libh3
+// writes straight into the returned zend_string as little-endian uint64
+// values and in H3_FORMAT_SET mode into a new H3IndexSet, otherwise a
+// scratch buffer is copied into a PHP array.
+typedef struct _php_h3_output
+{
+    zend_long format;
+    zend_string *packed;
+    zval set;
+    H3Index *indexes;
+    size_t capacity;
+} php_h3_output;
+
+// A set of indexes passed in as an array, a packed string or an H3IndexSet.
+// Packed strings (when the host byte order matches) and H3IndexSet buffers
+// are used in place, so owned is 0 then.
+typedef struct _php_h3_input
+{
+    H3Index *indexes;
+    size_t length;
+    zend_bool owned;
+} php_h3_input;
+
+#ifdef WORDS_BIGENDIAN
+static void php_h3_swap_indexes(H3Index *indexes, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        H3Index v = indexes[i];
+        v = ((v & 0x00000000ffffffffULL) << 32) | ((v & 0xffffffff00000000ULL) >> 32);
+        v = ((v & 0x0000ffff0000ffffULL) << 16) | ((v & 0xffff0000ffff0000ULL) >> 16);
+        v = ((v & 0x00ff00ff00ff00ffULL) << 8) | ((v & 0xff00ff00ff00ff00ULL) >> 8);
+        indexes[i] = v;
+    }
+}
+#endif
+
+// zero clears the buffer first, which libh3 needs wherever it leaves
+// H3_NULL holes or stops early: children of pentagons, compact, uncompact
+// and polyfill.
+static H3Index *php_h3_output_init_ex(php_h3_output *out, zend_long format, size_t capacity, int zero)
+{
+    // one spare slot is kept for the array format
+    if (capacity >= SIZE_MAX / sizeof(H3Index))
+    {
+        zend_error_noreturn(E_ERROR, "Possible integer overflow in memory allocation (%zu * %zu)", capacity, sizeof(H3Index));
+    }
+
+    out->format = format;
+    out->packed = NULL;
+    out->capacity = capacity;
+    ZVAL_UNDEF(&out->set);
+
+    if (format == PHP_H3_FORMAT_PACKED)
+    {
+        out->packed = zend_string_alloc(capacity * sizeof(H3Index), 0);
+        out->indexes = (H3Index *)ZSTR_VAL(out->packed);
+        if (zero)
+        {
+            memset(out->indexes, 0, capacity * sizeof(H3Index));
+        }
+    }
+    else if (format == PHP_H3_FORMAT_SET)
+    {
+        php_h3_index_set *set;
+
+        object_init_ex(&out->set, php_h3_index_set_ce);
+        set = Z_H3_INDEX_SET_P(&out->set);
+        php_h3_index_set_reserve(set, capacity > 0 ? capacity : 1);
+        out->indexes = set->indexes;
+        if (zero)
+        {
+            memset(out->indexes, 0, set->capacity * sizeof(H3Index));
+        }
+    }
+    else
+    {
+        out->indexes = (H3Index *)php_h3_arena_alloc((capacity + 1) * sizeof(H3Index), zero);
+    }
+
+    return out->indexes;
+}
+
+static H3Index *php_h3_output_init(php_h3_output *out, zend_long format, size_t capacity)
+{
+    return php_h3_output_init_ex(out, format, capacity, 1);
+}
+
+static void php_h3_output_free(php_h3_output *out)
+{
+    if (out->packed != NULL)
+    {
+        zend_string_free(out->packed);
+    }
+    else if (Z_TYPE(out->set) == IS_OBJECT)
+    {
+        zval_ptr_dtor(&out->set);
+        ZVAL_UNDEF(&out->set);
+    }
+    else
+    {
+        php_h3_arena_free(out->indexes);
+    }
+    out->indexes = NULL;
+    out->packed = NULL;
+}
+
+// Moves the non-zero indexes to the front of the buffer in a single pass and
+// returns how many there are. libh3 leaves H3_NULL holes in buffers sized by
+// its max*Size estimates: kRing next to pentagons, the children of a
+// pentagon, uncompact and polyfill.
+static size_t php_h3_trim_indexes(H3Index *indexes, size_t count)
+{
+    size_t kept = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (indexes[i] != 0)
+        {
+            indexes[kept++] = indexes[i];
+        }
+    }
+
+    return kept;
+}
+
+// Result arrays are created at their final size as packed arrays and
+// filled without per-element checks or rehashing.
+static void php_h3_packed_array_init(zval *array, uint32_t capacity)
+{
+    array_init_size(array, capacity);
+#if PHP_VERSION_ID >= 70300
+    zend_hash_real_init_packed(Z_ARRVAL_P(array));
+#else
+    zend_hash_real_init(Z_ARRVAL_P(array), 1);
+#endif
+}
+
+static void php_h3_array_from_indexes(zval *array, const H3Index *indexes, size_t count)
+{
+    php_h3_packed_array_init(array, (uint32_t)count);
+
+    ZEND_HASH_FILL_PACKED(Z_ARRVAL_P(array))
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            zval value;
+            ZVAL_LONG(&value, indexes[i]);
+            ZEND_HASH_FILL_ADD(&value);
+        }
+    }
+    ZEND_HASH_FILL_END();
+}
+
+static void php_h3_array_from_ints(zval *array, const int *values, size_t count)
+{
+    php_h3_packed_array_init(array, (uint32_t)count);
+
+    ZEND_HASH_FILL_PACKED(Z_ARRVAL_P(array))
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            zval value;
+            ZVAL_LONG(&value, values[i]);
+            ZEND_HASH_FILL_ADD(&value);
+        }
+    }
+    ZEND_HASH_FILL_END();
+}
+
+// ZEND_HASH_FILL_PACKED can only fill one array at a time. These do the
+// same steps for callers that fill several presized arrays in one loop:
+// set each slot in order, then close the array with the final count.
+static inline void php_h3_packed_array_set(zval *array, uint32_t idx, zend_long value)
+{
+#if PHP_VERSION_ID >= 80200
+    ZVAL_LONG(&Z_ARRVAL_P(array)->arPacked[idx], value);
+#else
+    Bucket *bucket = Z_ARRVAL_P(array)->arData + idx;
+
+    ZVAL_LONG(&bucket->val, value);
+    bucket->h = idx;
+    bucket->key = NULL;
+#endif
+}
+
+static inline void php_h3_packed_array_done(zval *array, uint32_t count)
+{
+    HashTable *ht = Z_ARRVAL_P(array);
+
+    ht->nNumUsed = count;
+    ht->nNumOfElements = count;
+    ht->nNextFreeElement = count;
+#if PHP_VERSION_ID >= 70300
+    ht->nInternalPointer = 0;
+#else
+    ht->nInternalPointer = count ? 0 : HT_INVALID_IDX;
+#endif
+}
+
+// Hands the first count indexes of the buffer back to PHP and releases it.
+static void php_h3_output_return(php_h3_output *out, size_t count, zval *return_value)
+{
+    if (out->packed != NULL)
+    {
+        zend_string *packed = out->packed;
+
+#ifdef WORDS_BIGENDIAN
+        php_h3_swap_indexes(out->indexes, count);
+#endif
+        if (count < out->capacity)
+        {
+            packed = zend_string_truncate(packed, count * sizeof(H3Index), 0);
+        }
+        ZSTR_VAL(packed)[ZSTR_LEN(packed)] = '\0';
+        out->packed = NULL;
+        out->indexes = NULL;
+
+        RETVAL_NEW_STR(packed);
+        return;
+    }
+
+    if (Z_TYPE(out->set) == IS_OBJECT)
+    {
+        Z_H3_INDEX_SET_P(&out->set)->count = count;
+        ZVAL_COPY_VALUE(return_value, &out->set);
+        ZVAL_UNDEF(&out->set);
+        out->indexes = NULL;
+        return;
+    }
+
+    php_h3_array_from_indexes(return_value, out->indexes, count);
+    php_h3_output_free(out);
+}
+
+static int php_h3_input_init(php_h3_input *in, zval *set_zval)
+{
+    in->indexes = NULL;
+    in->length = 0;
+    in->owned = 0;
+
+    if (Z_TYPE_P(set_zval) == IS_OBJECT && Z_OBJCE_P(set_zval) == php_h3_index_set_ce)
+    {
+        php_h3_index_set *set = Z_H3_INDEX_SET_P(set_zval);
+
+        in->indexes = set->indexes;
+        in->length = set->count;
+        return SUCCESS;
+    }
+
+    if (Z_TYPE_P(set_zval) == IS_ARRAY)
+    {
+        zval *h3Indexed_zval;
+        size_t i = 0;
+
+        in->length = zend_hash_num_elements(Z_ARRVAL_P(set_zval));
+        in->indexes = (H3Index *)calloc(in->length + 1, sizeof(H3Index));
+        in->owned = 1;
+
+        ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(set_zval), h3Indexed_zval)
+        {
+            in->indexes[i++] = zval_get_long(h3Indexed_zval);
+        }
+        ZEND_HASH_FOREACH_END();
+
+        return SUCCESS;
+    }
+
+    if (Z_TYPE_P(set_zval) == IS_STRING)
+    {
+        if (Z_STRLEN_P(set_zval) % sizeof(H3Index) != 0)
+        {
+            php_error_docref(NULL, E_WARNING, "Packed index sets must be a sequence of uint64 values");
+            return FAILURE;
+        }
+
+        in->length = Z_STRLEN_P(set_zval) / sizeof(H3Index);
+#ifdef WORDS_BIGENDIAN
+        in->indexes = (H3Index *)calloc(in->length + 1, sizeof(H3Index));
+        in->owned = 1;
+        memcpy(in->indexes, Z_STRVAL_P(set_zval), Z_STRLEN_P(set_zval));
+        php_h3_swap_indexes(in->indexes, in->length);
+#else
+        // zend_string values are 8-byte aligned, so the buffer can be used as is
+        in->indexes = (H3Index *)Z_STRVAL_P(set_zval);
+#endif
+        return SUCCESS;
+    }
+
+    php_error_docref(NULL, E_WARNING, "Index sets must be given as an array, a packed string or an H3IndexSet");
+    return FAILURE;
+}
+
+// Returns a result stored as native uint64 values in the requested format.
+static void php_h3_return_cached(zend_string *cached, zend_long format, zval *return_value)
+{
+    size_t count = ZSTR_LEN(cached) / sizeof(H3Index);
+    php_h3_output out;
+
+#ifndef WORDS_BIGENDIAN
+    if (format == PHP_H3_FORMAT_PACKED)
+    {
+        RETURN_STR_COPY(cached);
+    }
+#endif
+
+    H3Index *outs = php_h3_output_init(&out, format, count);
+    memcpy(outs, ZSTR_VAL(cached), ZSTR_LEN(cached));
+    php_h3_output_return(&out, count, return_value);
+}
+
+static void php_h3_input_free(php_h3_input *in)
+{
+    if (in->owned)
+    {
+        free(in->indexes);
+    }
+    in->indexes = NULL;
+    in->length = 0;
+}
+
+// libh3 takes set sizes as int, so larger sets are refused (and released)
+// instead of being truncated on the way in.
+static int php_h3_input_check_int(php_h3_input *in)
+{
+    if (in->length > INT_MAX)
+    {
+        php_error_docref(NULL, E_WARNING, "Index sets passed to libh3 can hold at most %d indexes", INT_MAX);
+        php_h3_input_free(in);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+/* }}} */
+
+/* {{{ shared memory result cache
+ */
+#define PHP_H3_SHM_KIND_POLYFILL 1
+#define PHP_H3_SHM_KIND_KRING 2
+
+// kRing results below this k are cheaper to compute than to look up
+#define PHP_H3_SHM_KRING_MIN_K 16
+
+#ifdef PHP_H3_SHM_CACHE
+// Cache of computed cell sets in anonymous shared memory, mapped in MINIT so
+// that forked fpm children share it. Slots are grouped into sets of
+// PHP_H3_SHM_WAYS; a key can only live in its own set and the least recently
+// used way is replaced. Readers never lock: every slot carries a sequence
+// number that is odd while a writer is copying into it, and readers retry
+// elsewhere (or miss) when it changed under them. Writers take a try-lock and
+// simply skip the store when another live writer holds it.
+#define PHP_H3_SHM_WAYS 8
+
+// slots are cache line aligned so that writers do not share lines
+#define PHP_H3_SHM_ALIGN(size) (((size) + 63) & ~((size_t)63))
+
+// The payload after the slot holds the key, padded to 8 bytes, then the
+// cells. The hashes only pick the set and filter ways cheaply; a hit also
+// needs the kind and the key bytes to match.
+typedef struct _php_h3_shm_slot
+{
+    uint32_t seq;
+    uint32_t count;
+    uint32_t kind;
+    uint32_t key_len;
+    uint64_t key_hash;
+    uint64_t key_check;
+    uint64_t last_used;
+} php_h3_shm_slot;
+
+#define PHP_H3_SHM_KEY_SPACE(key_len) (((size_t)(key_len) + 7) & ~(size_t)7)
+
+typedef struct _php_h3_shm_header
+{
+    // pid of the writer holding it, 0 while free
+    uint64_t lock;
+    uint64_t sets;
+    uint64_t slot_size;
+    uint64_t clock;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t busy;
+    uint64_t recovered;
+    uint32_t ways;
+} php_h3_shm_header;
+
+static php_h3_shm_header *php_h3_shm = NULL;
+static size_t php_h3_shm_length = 0;
+
+static php_h3_shm_slot *php_h3_shm_slot_at(uint64_t set, uint32_t way)
+{
+    char *slots = (char *)php_h3_shm + PHP_H3_SHM_ALIGN(sizeof(php_h3_shm_header));
+
+    return (php_h3_shm_slot *)(slots + (set * php_h3_shm->ways + way) * php_h3_shm->slot_size);
+}
+
+static size_t php_h3_shm_payload_size(void)
+{
+    return php_h3_shm->slot_size - sizeof(php_h3_shm_slot);
+}
+
+static void php_h3_shm_startup(zend_long size, zend_long entry_size)
+{
+    size_t header_size = PHP_H3_SHM_ALIGN(sizeof(php_h3_shm_header));
+    size_t slot_size, sets;
+    void *mapped;
+
+    if (size <= 0 || entry_size <= 0)
+    {
+        return;
+    }
+
+    slot_size = PHP_H3_SHM_ALIGN(sizeof(php_h3_shm_slot) + (size_t)entry_size);
+    if ((size_t)size < header_size + slot_size * PHP_H3_SHM_WAYS)
+    {
+        php_error_docref(NULL, E_WARNING, "h3.shm_cache_size is too small for a single set of h3.shm_cache_entry_size entries, the shared cache is disabled");
+        return;
+    }
+    sets = ((size_t)size - header_size) / (slot_size * PHP_H3_SHM_WAYS);
+
+    mapped = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED)
+    {
+        php_error_docref(NULL, E_WARNING, "Unable to map %ld bytes for the h3 shared cache", (long)size);
+        return;
+    }
+
+    // anonymous mappings are zero filled, so every slot starts out empty
+    php_h3_shm = (php_h3_shm_header *)mapped;
+    php_h3_shm_length = (size_t)size;
+    php_h3_shm->ways = PHP_H3_SHM_WAYS;
+    php_h3_shm->sets = sets;
+    php_h3_shm->slot_size = slot_size;
+}
+
+static void php_h3_shm_shutdown(void)
+{
+    if (php_h3_shm != NULL)
+    {
+        munmap((void *)php_h3_shm, php_h3_shm_length);
+        php_h3_shm = NULL;
+        php_h3_shm_length = 0;
+    }
+}
+
+// Takes the writer lock, or breaks it when its owner has exited (killed fpm
+// child). A slow writer is never preempted, so only the owner ever moves a
+// slot's sequence. Returns 0 when a live writer holds it.
+static int php_h3_shm_lock(void)
+{
+    uint64_t mine = (uint64_t)(uint32_t)getpid();
+    uint64_t held = 0;
+
+    if (__atomic_compare_exchange_n(&php_h3_shm->lock, &held, mine, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        return 1;
+    }
+
+    if (!(kill((pid_t)held, 0) == -1 && errno == ESRCH))
+    {
+        return 0;
+    }
+
+    // only one of the writers that saw the same dead owner wins
+    if (!__atomic_compare_exchange_n(&php_h3_shm->lock, &held, mine, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        return 0;
+    }
+
+    __atomic_add_fetch(&php_h3_shm->recovered, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+static void php_h3_shm_unlock(void)
+{
+    __atomic_store_n(&php_h3_shm->lock, 0, __ATOMIC_RELEASE);
+}
+
+// Two FNV-1a hashes of the key, one over its bytes forward and one
+// backward. They are not collision resistant and the key may come from user
+// polygons, so they only narrow the search; slots are matched on the stored
+// key itself.
+static void php_h3_shm_hash(int kind, const char *key, size_t key_len, uint64_t *hash, uint64_t *check)
+{
+    uint64_t h1 = 0xcbf29ce484222325ULL ^ (uint64_t)kind;
+    uint64_t h2 = 0x84222325cbf29ce4ULL ^ ((uint64_t)kind << 32);
+
+    for (size_t i = 0; i < key_len; i++)
+    {
+        h1 = (h1 ^ (unsigned char)key[i]) * 0x100000001b3ULL;
+        h2 = (h2 ^ (unsigned char)key[key_len - 1 - i]) * 0x100000001b3ULL;
+    }
+
+    *hash = h1;
+    *check = h2 ^ (uint64_t)key_len;
+}
+
+static zend_string *php_h3_shm_find(int kind, const char *key, size_t key_len)
+{
+    uint64_t hash, check;
+
+    if (php_h3_shm == NULL)
+    {
+        return NULL;
+    }
+
+    php_h3_shm_hash(kind, key, key_len, &hash, &check);
+
+    uint64_t set = hash % php_h3_shm->sets;
+
+    for (uint32_t way = 0; way < php_h3_shm->ways; way++)
+    {
+        php_h3_shm_slot *slot = php_h3_shm_slot_at(set, way);
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        if ((seq & 1) || slot->key_hash != hash || slot->key_check != check || slot->kind != (uint32_t)kind || slot->key_len != key_len)
+        {
+            continue;
+        }
+
+        size_t bytes = (size_t)slot->count * sizeof(H3Index);
+        if (PHP_H3_SHM_KEY_SPACE(key_len) + bytes > php_h3_shm_payload_size() || memcmp((char *)(slot + 1), key, key_len) != 0)
+        {
+            continue;
+        }
+
+        zend_string *cells = zend_string_alloc(bytes, 0);
+        memcpy(ZSTR_VAL(cells), (char *)(slot + 1) + PHP_H3_SHM_KEY_SPACE(key_len), bytes);
+        ZSTR_VAL(cells)[bytes] = '\0';
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq)
+        {
+            // overwritten while copying
+            zend_string_free(cells);
+            continue;
+        }
+
+        __atomic_store_n(&slot->last_used, __atomic_add_fetch(&php_h3_shm->clock, 1, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+        __atomic_add_fetch(&php_h3_shm->hits, 1, __ATOMIC_RELAXED);
+        return cells;
+    }
+
+    __atomic_add_fetch(&php_h3_shm->misses, 1, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+static void php_h3_shm_store(int kind, const char *key, size_t key_len, const H3Index *cells, size_t count)
+{
+    uint64_t hash, check;
+
+    if (php_h3_shm == NULL || key_len > UINT32_MAX || PHP_H3_SHM_KEY_SPACE(key_len) + count * sizeof(H3Index) > php_h3_shm_payload_size())
+    {
+        return;
+    }
+
+    if (!php_h3_shm_lock())
+    {
+        __atomic_add_fetch(&php_h3_shm->busy, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    php_h3_shm_hash(kind, key, key_len, &hash, &check);
+
+    uint64_t set = hash % php_h3_shm->sets;
+    php_h3_shm_slot *victim = NULL;
+
+    for (uint32_t way = 0; way < php_h3_shm->ways; way++)
+    {
+        php_h3_shm_slot *slot = php_h3_shm_slot_at(set, way);
+
+        if (slot->key_hash == hash && slot->key_check == check && slot->kind == (uint32_t)kind && slot->key_len == key_len && memcmp((char *)(slot + 1), key, key_len) == 0)
+        {
+            victim = slot;
+            break;
+        }
+        // a slot left odd by a writer that died holds a torn entry nobody can read
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) & 1)
+        {
+            victim = slot;
+            continue;
+        }
+        if (victim == NULL || ((victim->seq & 1) == 0 && __atomic_load_n(&slot->last_used, __ATOMIC_RELAXED) < __atomic_load_n(&victim->last_used, __ATOMIC_RELAXED)))
+        {
+            victim = slot;
+        }
+    }
+
+    uint32_t seq = victim->seq;
+
+    // make an abandoned odd sequence even again, so the bumps below leave it
+    // even and readers see the slot once more
+    if (seq & 1)
+    {
+        seq++;
+    }
+
+    __atomic_store_n(&victim->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    victim->key_hash = hash;
+    victim->key_check = check;
+    victim->kind = (uint32_t)kind;
+    victim->key_len = (uint32_t)key_len;
+    victim->count = (uint32_t)count;
+    memcpy((char *)(victim + 1), key, key_len);
+    memcpy((char *)(victim + 1) + PHP_H3_SHM_KEY_SPACE(key_len), cells, count * sizeof(H3Index));
+
+    __atomic_store_n(&victim->seq, seq + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&victim->last_used, __atomic_add_fetch(&php_h3_shm->clock, 1, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    __atomic_add_fetch(&php_h3_shm->stores, 1, __ATOMIC_RELAXED);
+
+    php_h3_shm_unlock();
+}
+
+#define php_h3_shm_enabled() (php_h3_shm != NULL)
+#else
+#define php_h3_shm_enabled() 0
+#define php_h3_shm_find(kind, key, key_len) NULL
+#define php_h3_shm_store(kind, key, key_len, cells, count)
+#endif
+/* }}} */
+
+/* {{{ precomputed tables
+ */
+#define PHP_H3_RES0_COUNT 122
+#define PHP_H3_PENTAGON_COUNT 12
+
+// Filled once in MINIT and read-only afterwards, so they are shared by all
+// threads without locking.
+static H3Index php_h3_res0_cells[PHP_H3_RES0_COUNT];
+static H3Index php_h3_pentagons[MAX_H3_RES + 1][PHP_H3_PENTAGON_COUNT];
+static GeoCoord php_h3_pentagon_centers[MAX_H3_RES + 1][PHP_H3_PENTAGON_COUNT];
+static uint64_t php_h3_pentagon_base_cells[2];
+
+// The same tables as interned little-endian packed strings and, from 7.3 on,
+// as immutable arrays that are handed out without copying.
+static zend_string *php_h3_res0_packed;
+static zend_string *php_h3_pentagons_packed[MAX_H3_RES + 1];
+#if PHP_VERSION_ID >= 70300
+static HashTable *php_h3_res0_array;
+static HashTable *php_h3_pentagons_array[MAX_H3_RES + 1];
+#endif
+
+// Same answer as h3IsPentagon() without the call: a cell is a pentagon when
+// its base cell is one and every digit down to its resolution is 0.
+static inline int php_h3_is_pentagon(H3Index h)
+{
+    int base_cell = (int)((h >> 45) & 0x7F);
+    int res = (int)((h >> 52) & 0xF);
+
+    if (base_cell >= PHP_H3_RES0_COUNT || !(php_h3_pentagon_base_cells[base_cell >> 6] & (1ULL << (base_cell & 63))))
+    {
+        return 0;
+    }
+
+    return res == 0 || ((h >> (3 * (MAX_H3_RES - res))) & ((1ULL << (3 * res)) - 1)) == 0;
+}
+
+// Tells whether the k-ring of origin may contain a pentagon, in which case
+// hexRange() would give up part way. Centers k steps apart are less than 3k
+// average edges apart, so a pentagon further than 3(k + 1) edges cannot be
+// reached.
+static int php_h3_disk_near_pentagon(H3Index origin, int k)
+{
+    int res = (int)((origin >> 52) & 0xF);
+    double reach_km = 3.0 * (k + 1) * edgeLengthKm(res);
+    GeoCoord center;
+
+    h3ToGeo(origin, &center);
+    for (int i = 0; i < PHP_H3_PENTAGON_COUNT; i++)
+    {
+        if (pointDistKm(&center, &php_h3_pentagon_centers[res][i]) <= reach_km)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static zend_string *php_h3_table_packed(const H3Index *indexes, size_t count)
+{
+    zend_string *packed = zend_string_init((const char *)indexes, count * sizeof(H3Index), 1);
+
+#ifdef WORDS_BIGENDIAN
+    php_h3_swap_indexes((H3Index *)ZSTR_VAL(packed), count);
+#endif
+
+    return zend_new_interned_string(packed);
+}
+
+#if PHP_VERSION_ID >= 70300
+static HashTable *php_h3_table_array(const H3Index *indexes, size_t count)
+{
+    HashTable *ht = (HashTable *)pemalloc(sizeof(HashTable), 1);
+
+    zend_hash_init(ht, count, NULL, NULL, 1);
+    zend_hash_real_init_packed(ht);
+    for (size_t i = 0; i < count; i++)
+    {
+        zval value;
+        ZVAL_LONG(&value, indexes[i]);
+        zend_hash_next_index_insert_new(ht, &value);
+    }
+
+    GC_SET_REFCOUNT(ht, 2);
+    GC_ADD_FLAGS(ht, IS_ARRAY_IMMUTABLE);
+
+    return ht;
+}
+#endif
+
+static void php_h3_tables_startup(void)
+{
+    getRes0Indexes(php_h3_res0_cells);
+    for (int i = 0; i < PHP_H3_RES0_COUNT; i++)
+    {
+        int base_cell = (int)((php_h3_res0_cells[i] >> 45) & 0x7F);
+
+        if (h3IsPentagon(php_h3_res0_cells[i]))
+        {
+            php_h3_pentagon_base_cells[base_cell >> 6] |= 1ULL << (base_cell & 63);
+        }
+    }
+
+    php_h3_res0_packed = php_h3_table_packed(php_h3_res0_cells, PHP_H3_RES0_COUNT);
+#if PHP_VERSION_ID >= 70300
+    php_h3_res0_array = php_h3_table_array(php_h3_res0_cells, PHP_H3_RES0_COUNT);
+#endif
+
+    for (int res = 0; res <= MAX_H3_RES; res++)
+    {
+        getPentagonIndexes(res, php_h3_pentagons[res]);
+        for (int i = 0; i < PHP_H3_PENTAGON_COUNT; i++)
+        {
+            h3ToGeo(php_h3_pentagons[res][i], &php_h3_pentagon_centers[res][i]);
+        }
+        php_h3_pentagons_packed[res] = php_h3_table_packed(php_h3_pentagons[res], PHP_H3_PENTAGON_COUNT);
+#if PHP_VERSION_ID >= 70300
+        php_h3_pentagons_array[res] = php_h3_table_array(php_h3_pentagons[res], PHP_H3_PENTAGON_COUNT);
+#endif
+    }
+}
+
+static void php_h3_tables_shutdown(void)
+{
+#if PHP_VERSION_ID >= 70300
+    zend_hash_destroy(php_h3_res0_array);
+    pefree(php_h3_res0_array, 1);
+    for (int res = 0; res <= MAX_H3_RES; res++)
+    {
+        zend_hash_destroy(php_h3_pentagons_array[res]);
+        pefree(php_h3_pentagons_array[res], 1);
+    }
+#endif
+    // the packed strings are interned and released by the engine
+}
+
+// Returns a table in the requested format, sharing the precomputed copy
+// whenever the format allows it.
+static void php_h3_table_return(const H3Index *indexes, size_t count, zend_string *packed, HashTable *array, zend_long format, zval *return_value)
+{
+    if (format == PHP_H3_FORMAT_PACKED)
+    {
+        ZVAL_INTERNED_STR(return_value, packed);
+        return;
+    }
+
+    if (format == PHP_H3_FORMAT_ARRAY && array != NULL)
+    {
+        Z_ARR_P(return_value) = array;
+        Z_TYPE_INFO_P(return_value) = IS_ARRAY;
+        return;
+    }
+
+    php_h3_output out;
+    H3Index *outs = php_h3_output_init(&out, format, count);
+
+    memcpy(outs, indexes, count * sizeof(H3Index));
+    php_h3_output_return(&out, count, return_value);
+}
+/* }}} */
+
+/* {{{ call statistics
+ */
+// With h3.stats on, MINIT points every function of the extension at
+// php_h3_stats_handler(), which times the original handler and counts its
+// output. Each function keeps its slot number in a reserved pointer of its
+// zend_function. The counters live in the module globals, so every thread
+// has its own copy under ZTS and no atomics are needed.
+typedef void (*php_h3_handler)(INTERNAL_FUNCTION_PARAMETERS);
+
+static int php_h3_stats_resource = -1;
+static size_t php_h3_stats_count;
+static php_h3_handler php_h3_stats_handlers[PHP_H3_STATS_MAX_FUNCTIONS];
+static zend_string *php_h3_stats_names[PHP_H3_STATS_MAX_FUNCTIONS];
+
+static inline zend_ulong php_h3_stats_now(void)
+{
+#ifdef PHP_WIN32
+    LARGE_INTEGER counter, frequency;
+
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (zend_ulong)(counter.QuadPart * (1e9 / frequency.QuadPart));
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (zend_ulong)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static void php_h3_stats_handler(INTERNAL_FUNCTION_PARAMETERS)
+{
+    size_t slot = (size_t)EX(func)->internal_function.reserved[php_h3_stats_resource] - 1;
+    php_h3_stats_entry *entry = &H3_G(stats)[slot];
+    zend_ulong start = php_h3_stats_now();
+
+    php_h3_stats_handlers[slot](INTERNAL_FUNCTION_PARAM_PASSTHRU);
+
+    entry->ns += php_h3_stats_now() - start;
+    entry->calls++;
+
+    // cells for arrays and index sets, bytes for packed and serialized output
+    if (Z_TYPE_P(return_value) == IS_ARRAY)
+    {
+        entry->cells += zend_hash_num_elements(Z_ARRVAL_P(return_value));
+    }
+    else if (Z_TYPE_P(return_value) == IS_STRING)
+    {
+        entry->bytes += Z_STRLEN_P(return_value);
+    }
+    else if (Z_TYPE_P(return_value) == IS_OBJECT && Z_OBJCE_P(return_value) == php_h3_index_set_ce)
+    {
+        entry->cells += Z_H3_INDEX_SET_P(return_value)->count;
+    }
+}
+
+static void php_h3_stats_startup(void)
+{
+    zend_function *fn;
+#if PHP_VERSION_ID < 80000
+    static zend_extension php_h3_stats_extension;
+#endif
+
+#if PHP_VERSION_ID >= 80000
+    php_h3_stats_resource = zend_get_resource_handle("h3");
+#else
+    php_h3_stats_resource = zend_get_resource_handle(&php_h3_stats_extension);
+#endif
+    if (php_h3_stats_resource < 0)
+    {
+        php_error_docref(NULL, E_WARNING, "h3.stats is on but no reserved function slot is left, statistics are disabled");
+        return;
+    }
+
+    ZEND_HASH_FOREACH_PTR(CG(function_table), fn)
+    {
+        if (fn->type != ZEND_INTERNAL_FUNCTION || fn->internal_function.module == NULL || strcmp(fn->internal_function.module->name, "h3") != 0)
+        {
+            continue;
+        }
+        if (zend_string_equals_literal(fn->common.function_name, "h3_stats") || zend_string_equals_literal(fn->common.function_name, "h3_stats_reset") || zend_string_equals_literal(fn->common.function_name, "h3_arena_stats"))
+        {
+            continue;
+        }
+        if (php_h3_stats_count == PHP_H3_STATS_MAX_FUNCTIONS)
+        {
+            break;
+        }
+
+        php_h3_stats_names[php_h3_stats_count] = fn->common.function_name;
+        php_h3_stats_handlers[php_h3_stats_count] = fn->internal_function.handler;
+        fn->internal_function.reserved[php_h3_stats_resource] = (void *)(php_h3_stats_count + 1);
+        fn->internal_function.handler = php_h3_stats_handler;
+        php_h3_stats_count++;
+    }
+    ZEND_HASH_FOREACH_END();
+}
+/* }}} */
+
+/* {{{ worker threads
+ */
+// upper bound for h3.polyfill_threads and per-call thread counts
+#define PHP_H3_MAX_THREADS 64
+
+typedef void (*php_h3_parallel_task)(void *ctx, size_t index);
+
+typedef struct _php_h3_parallel_job
+{
+    php_h3_parallel_task task;
+    void *ctx;
+    size_t count;
+    size_t next;
+} php_h3_parallel_job;
+
+static void php_h3_parallel_drain(php_h3_parallel_job *job)
+{
+    for (;;)
+    {
+#ifdef PHP_H3_THREADS
+        size_t index = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+#else
+        size_t index = job->next++;
+#endif
+        if (index >= job->count)
+        {
+            return;
+        }
+        job->task(job->ctx, index);
+    }
+}
+
+#ifdef PHP_H3_THREADS
+static void *php_h3_parallel_worker(void *arg)
+{
+    php_h3_parallel_drain((php_h3_parallel_job *)arg);
+    return NULL;
+}
+#endif
+
+// Runs task(ctx, 0..count-1) on up to the given number of threads, the
+// calling one included, and returns when every index is done. Tasks run
+// outside of the engine: they must only call libh3 and malloc/free, never
+// emalloc or anything else that touches request or thread-local state, which
+// keeps them safe on ZTS builds too. Without pthreads everything runs inline.
+static void php_h3_parallel_for(size_t count, zend_long threads, php_h3_parallel_task task, void *ctx)
+{
+    php_h3_parallel_job job = {task, ctx, count, 0};
+
+#ifdef PHP_H3_THREADS
+    pthread_t workers[PHP_H3_MAX_THREADS];
+    int started = 0;
+
+    if (threads > PHP_H3_MAX_THREADS)
+    {
+        threads = PHP_H3_MAX_THREADS;
+    }
+    if ((size_t)threads > count)
+    {
+        threads = (zend_long)count;
+    }
+
+    // a worker that fails to start just leaves more work for the others
+    for (int i = 1; i < threads; i++)
+    {
+        if (pthread_create(&workers[started], NULL, php_h3_parallel_worker, &job) == 0)
+        {
+            started++;
+        }
+    }
+
+    php_h3_parallel_drain(&job);
+
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+#else
+    (void)threads;
+    php_h3_parallel_drain(&job);
+#endif
+}
+/* }}} */
+
+PHP_FUNCTION(geoToH3)
+{
+    zend_long resolution;
+    double lat, lon;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ddl", &lat, &lon, &resolution) == FAILURE)
+    {
+        return;
+    }
+
+    GeoCoord location;
+    location.lat = degsToRads(lat);
+    location.lon = degsToRads(lon);
+
+    H3Index indexed = geoToH3(&location, resolution);
+
+    RETURN_LONG(indexed);
+}
+
+// Converts an interleaved lat/lon buffer from degrees to radians in place.
+// Kept as a flat loop over doubles so the compiler can vectorize it; the
+// factor matches libh3's degsToRads so results are identical to geoToH3().
+static void php_h3_degs_to_rads_buffer(double *coords, size_t count)
+{
+    const double factor = PHP_H3_DEG_TO_RAD;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        coords[i] *= factor;
+    }
+}
+
+// Converts a buffer of doubles from radians to degrees in place; the
+// counterpart of php_h3_degs_to_rads_buffer with radsToDegs()'s factor.
+static void php_h3_rads_to_degs_buffer(double *coords, size_t count)
+{
+    const double factor = PHP_H3_RAD_TO_DEG;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        coords[i] *= factor;
+    }
+}
+
+// Reads parallel lat/lon arrays into an interleaved lat/lon double buffer.
+static double *php_h3_coords_from_arrays(zval *lats_zval, zval *lons_zval, size_t *count)
+{
+    HashTable *lats = Z_ARRVAL_P(lats_zval);
+    HashTable *lons = Z_ARRVAL_P(lons_zval);
+    size_t length = zend_hash_num_elements(lats);
+
+    if (length != zend_hash_num_elements(lons))
+    {
+        php_error_docref(NULL, E_WARNING, "Latitude and longitude arrays must have the same number of elements");
+        return NULL;
+    }
+
+    double *coords = (double *)calloc(length * 2 + 1, sizeof(double));
+    zval *coord_zval;
+    size_t i = 0;
+
+    ZEND_HASH_FOREACH_VAL(lats, coord_zval)
+    {
+        coords[i * 2] = zval_get_double(coord_zval);
+        i++;
+    }
+    ZEND_HASH_FOREACH_END();
+
+    i = 0;
+    ZEND_HASH_FOREACH_VAL(lons, coord_zval)
+    {
+        coords[i * 2 + 1] = zval_get_double(coord_zval);
+        i++;
+    }
+    ZEND_HASH_FOREACH_END();
+
+    *count = length;
+    return coords;
+}
+
+// Reads a packed string of native float64 lat/lon pairs (pack('d*')) into a double buffer.
+static double *php_h3_coords_from_packed(const char *packed, size_t packed_len, size_t *count)
+{
+    if (packed_len % (2 * sizeof(double)) != 0)
+    {
+        php_error_docref(NULL, E_WARNING, "Packed coordinates must be a sequence of float64 lat/lon pairs");
+        return NULL;
+    }
+
+    size_t length = packed_len / (2 * sizeof(double));
+    double *coords = (double *)calloc(length * 2 + 1, sizeof(double));
+
+    memcpy(coords, packed, packed_len);
+
+    *count = length;
+    return coords;
+}
+
+PHP_FUNCTION(geoToH3Batch)
+{
+    zval *lats_zval, *lons_zval;
+    char *packed;
+    size_t packed_len, count;
+    zend_long resolution, format = PHP_H3_FORMAT_ARRAY;
+    double *coords;
+    php_h3_output out;
+
+    if (ZEND_NUM_ARGS() > 0 && Z_TYPE_P(ZEND_CALL_ARG(execute_data, 1)) == IS_STRING)
+    {
+        if (zend_parse_parameters(ZEND_NUM_ARGS(), "sl|l", &packed, &packed_len, &resolution, &format) == FAILURE)
+        {
+            return;
+        }
+
+        coords = php_h3_coords_from_packed(packed, packed_len, &count);
+    }
+    else
+    {
+        if (zend_parse_parameters(ZEND_NUM_ARGS(), "aal|l", &lats_zval, &lons_zval, &resolution, &format) == FAILURE)
+        {
+            return;
+        }
+
+        coords = php_h3_coords_from_arrays(lats_zval, lons_zval, &count);
+    }
+
+    if (coords == NULL)
+    {
+        RETURN_FALSE;
+    }
+
+    php_h3_degs_to_rads_buffer(coords, count * 2);
+
+    H3Index *outs = php_h3_output_init(&out, format, count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        GeoCoord location;
+        location.lat = coords[i * 2];
+        location.lon = coords[i * 2 + 1];
+
+        outs[i] = geoToH3(&location, resolution);
+    }
+
+    free(coords);
+
+    php_h3_output_return(&out, count, return_value);
+}
+
+PHP_FUNCTION(h3ToGeo)
+{
+    zend_long indexed;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    {
+        return;
+    }
+
+    // Get the center coordinates.
+    GeoCoord center;
+    h3ToGeo(indexed, &center);
+
+    double lat_zval, lon_zval;
+    lat_zval = radsToDegs(center.lat);
+    lon_zval = radsToDegs(center.lon);
+
+    array_init_size(return_value, 2);
+    add_assoc_double(return_value, "lat", lat_zval);
+    add_assoc_double(return_value, "lon", lon_zval);
+}
+
+PHP_FUNCTION(h3ToGeoBoundary)
+{
+    zend_long indexed;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    {
+        return;
+    }
+
+    // Get the vertices of the H3 index.
+    GeoBoundary boundary;
+    h3ToGeoBoundary(indexed, &boundary);
+
+    array_init_size(return_value, boundary.numVerts);
+    // Indexes can have different number of vertices under some cases,
+    // which is why boundary.numVerts is needed.
+    for (int i = 0; i < boundary.numVerts; i++)
+    {
+        double lat, lon;
+
+        lat = radsToDegs(boundary.verts[i].lat);
+        lon = radsToDegs(boundary.verts[i].lon);
+
+        zval lat_lon_arr;
+        array_init_size(&lat_lon_arr, 2);
+        add_assoc_double(&lat_lon_arr, "lat", lat);
+        add_assoc_double(&lat_lon_arr, "lon", lon);
+
+        add_index_zval(return_value, i, &lat_lon_arr);
+    }
+}
+
+// Cell centers as one packed string of native float64 lat/lon pairs in
+// degrees, the same layout geoToH3Batch() accepts.
+PHP_FUNCTION(h3ToGeoBatch)
+{
+    zval *h3Set_zval;
+    php_h3_input in;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "z", &h3Set_zval) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_input_init(&in, h3Set_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    zend_string *coords = zend_string_alloc(in.length * sizeof(GeoCoord), 0);
+    GeoCoord *centers = (GeoCoord *)ZSTR_VAL(coords);
+
+    for (size_t i = 0; i < in.length; i++)
+    {
+        h3ToGeo(in.indexes[i], &centers[i]);
+    }
+
+    php_h3_input_free(&in);
+
+    php_h3_rads_to_degs_buffer((double *)centers, ZSTR_LEN(coords) / sizeof(double));
+    ZSTR_VAL(coords)[ZSTR_LEN(coords)] = '\0';
+
+    RETURN_NEW_STR(coords);
+}
+
+// Cell boundaries as ["verts" => packed float64 lat/lon pairs in degrees,
+// "offsets" => packed uint32], where the vertices of cell i are the pairs
+// offsets[i] up to offsets[i + 1].
+PHP_FUNCTION(h3ToGeoBoundaryBatch)
+{
+    zval *h3Set_zval;
+    php_h3_input in;
+    size_t verts_count = 0;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "z", &h3Set_zval) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_input_init(&in, h3Set_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    zend_string *verts = zend_string_alloc((size_t)in.length * MAX_CELL_BNDRY_VERTS * sizeof(GeoCoord), 0);
+    zend_string *offsets = zend_string_alloc(((size_t)in.length + 1) * sizeof(uint32_t), 0);
+    GeoCoord *coords = (GeoCoord *)ZSTR_VAL(verts);
+    uint32_t *starts = (uint32_t *)ZSTR_VAL(offsets);
+
+    for (size_t i = 0; i < in.length; i++)
+    {
+        GeoBoundary boundary;
+
+        h3ToGeoBoundary(in.indexes[i], &boundary);
+
+        starts[i] = (uint32_t)verts_count;
+        memcpy(&coords[verts_count], boundary.verts, boundary.numVerts * sizeof(GeoCoord));
+        verts_count += boundary.numVerts;
+    }
+    starts[in.length] = (uint32_t)verts_count;
+
+    php_h3_input_free(&in);
+
+    php_h3_rads_to_degs_buffer((double *)coords, verts_count * 2);
+
+    verts = zend_string_truncate(verts, verts_count * sizeof(GeoCoord), 0);
+    ZSTR_VAL(verts)[ZSTR_LEN(verts)] = '\0';
+    ZSTR_VAL(offsets)[ZSTR_LEN(offsets)] = '\0';
+
+    array_init_size(return_value, 2);
+    add_assoc_str(return_value, "verts", verts);
+    add_assoc_str(return_value, "offsets", offsets);
+}
+
+PHP_FUNCTION(h3GetResolution)
+{
+    zend_long indexed;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    {
+        return;
+    }
+
+    int resolution = h3GetResolution(indexed);
+
+    RETURN_LONG(resolution);
+}
+
+PHP_FUNCTION(h3GetBaseCell)
+{
+    zend_long indexed;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    {
+        return;
+    }
+
+    int base_cell = h3GetBaseCell(indexed);
+
+    RETURN_LONG(base_cell);
+}
+
+PHP_FUNCTION(stringToH3)
+{
+    char *str;
+    size_t str_len;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "s", &str, &str_len) == FAILURE)
+    {
+        return;
+    }
+
+    H3Index indexed = stringToH3(str);
+
+    RETURN_LONG(indexed);
+}
+
+PHP_FUNCTION(h3ToString)
+{
+    zend_long indexed;
+    char str[17] = "";
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    {
+        return;
+    }
+
+    h3ToString(indexed, str, 17);
+
+    RETURN_STRINGL(str, 17);
+}
+
+PHP_FUNCTION(h3IsValid)
+{
+    zend_long indexed;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    {
+        return;
+    }
+
+    if (h3IsValid(indexed) == 0)
+    {
+        RETURN_FALSE;
+    }
+    else
+    {
+        RETURN_TRUE;
+    }
+}
+
+PHP_FUNCTION(h3IsResClassIII)
+{
+    zend_long indexed;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    {
+        return;
+    }
+
+    if (h3IsResClassIII(indexed) == 0)
+    {
+        RETURN_FALSE;
+    }
+    else
+    {
+        RETURN_TRUE;
+    }
+}
+
+PHP_FUNCTION(h3IsPentagon)
+{
+    zend_long indexed;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    {
+        return;
+    }
+
+    RETURN_BOOL(php_h3_is_pentagon(indexed));
+}
+
+PHP_FUNCTION(h3GetFaces)
+{
+    zend_long indexed;
+    int arr_count;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    {
+        return;
+    }
+
+    arr_count = maxFaceCount(indexed);
+    int *outs = (int *)calloc(arr_count, sizeof(int));
+
+    h3GetFaces(indexed, outs);
+
+    php_h3_array_from_ints(return_value, outs, arr_count);
+    free(outs);
+}
+
+PHP_FUNCTION(maxFaceCount)
+{
+    zend_long indexed;
+    int count;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &indexed) == FAILURE)
+    {
+        return;
+    }
+
+    count = maxFaceCount(indexed);
+
+    RETURN_LONG(count);
+}
+
+// Largest k whose maxKringSize() still fits in libh3's int sizes
+#define PHP_H3_MAX_K 26754
+
+// Rejects a k no buffer can be sized for; a negative one would otherwise
+// wrap into a huge allocation before libh3 is even called.
+static int php_h3_check_k(zend_long k)
+{
+    if (k < 0 || k > PHP_H3_MAX_K)
+    {
+        php_error_docref(NULL, E_WARNING, "k must be between 0 and %d", PHP_H3_MAX_K);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+PHP_FUNCTION(kRing)
+{
+    zend_long indexed, k, format = PHP_H3_FORMAT_ARRAY;
+    php_h3_output out;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll|l", &indexed, &k, &format) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_check_k(k) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    // large rings are shared between processes through the shm cache
+    zend_long cache_key[2] = {indexed, k};
+    int shared = k >= PHP_H3_SHM_KRING_MIN_K && php_h3_shm_enabled();
+
+    if (shared)
+    {
+        zend_string *cached = php_h3_shm_find(PHP_H3_SHM_KIND_KRING, (const char *)cache_key, sizeof(cache_key));
+        if (cached != NULL)
+        {
+            php_h3_return_cached(cached, format, return_value);
+            zend_string_release(cached);
+            return;
+        }
+    }
+
+    int arr_count = maxKringSize(k);
+    // kRing() clears the buffer itself before it falls back
+    H3Index *outs = php_h3_output_init_ex(&out, format, arr_count, 0);
+
+    kRing(indexed, k, outs);
+    size_t count = php_h3_trim_indexes(outs, arr_count);
+
+    if (shared)
+    {
+        php_h3_shm_store(PHP_H3_SHM_KIND_KRING, (const char *)cache_key, sizeof(cache_key), outs, count);
+    }
+
+    php_h3_output_return(&out, count, return_value);
+}
+
+// Breadth-first k-ring built on 1-rings, the fallback libh3's kRing() runs
+// once its hexRange() attempt failed, but without repeating that attempt.
+// outs must hold maxKringSize(k) cells; returns how many were written, in
+// order of distance.
+static size_t php_h3_kring_bfs(H3Index origin, int k, H3Index *outs)
+{
+    php_h3_cell_map seen = {0};
+    size_t count = 0, ring_start = 0;
+
+    seen.type = PHP_H3_CELL_MAP_INT;
+    php_h3_cell_map_upsert(&seen, origin);
+    outs[count++] = origin;
+
+    for (int ring = 0; ring < k; ring++)
+    {
+        size_t ring_end = count;
+
+        for (size_t i = ring_start; i < ring_end; i++)
+        {
+            H3Index neighbors[7] = {0};
+
+            kRing(outs[i], 1, neighbors);
+            for (int n = 0; n < 7; n++)
+            {
+                size_t known = seen.count;
+
+                if (neighbors[n] == 0)
+                {
+                    continue;
+                }
+                php_h3_cell_map_upsert(&seen, neighbors[n]);
+                if (seen.count != known)
+                {
+                    outs[count++] = neighbors[n];
+                }
+            }
+        }
+        ring_start = ring_end;
+    }
+
+    efree(seen.keys);
+    efree(seen.values);
+
+    return count;
+}
+
+// Like kRing(), but skips the hexRange() attempt when a pentagon is within
+// reach and goes straight to the breadth-first walk, which libh3 only starts
+// after that attempt failed. usedFallback is set to whether the walk ran,
+// either because of a nearby pentagon or because hexRange() gave up.
+PHP_FUNCTION(kRingFast)
+{
+    zend_long indexed, k, format = PHP_H3_FORMAT_ARRAY;
+    zval *fallback_zval = NULL;
+    php_h3_output out;
+    int used_fallback;
+    size_t count;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll|zl", &indexed, &k, &fallback_zval, &format) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_check_k(k) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    if (!h3IsValid(indexed))
+    {
+        php_error_docref(NULL, E_WARNING, "Expected a valid index");
+        RETURN_FALSE;
+    }
+
+    int arr_count = maxKringSize(k);
+    H3Index *outs = php_h3_output_init_ex(&out, format, arr_count, 0);
+
+    // hexRange() is hexRangeDistances() without the distances; it fills the
+    // buffer without holes or gives up when it meets a pentagon, so near
+    // one the walk is not even tried
+    used_fallback = php_h3_disk_near_pentagon(indexed, (int)k) || hexRange(indexed, k, outs) != 0;
+    if (used_fallback)
+    {
+        count = php_h3_kring_bfs(indexed, (int)k, outs);
+    }
+    else
+    {
+        count = arr_count;
+    }
+
+    if (fallback_zval != NULL)
+    {
+#if PHP_VERSION_ID >= 70400
+        ZEND_TRY_ASSIGN_REF_BOOL(fallback_zval, used_fallback);
+#else
+        ZVAL_DEREF(fallback_zval);
+        zval_ptr_dtor(fallback_zval);
+        ZVAL_BOOL(fallback_zval, used_fallback);
+#endif
+    }
+
+    php_h3_output_return(&out, count, return_value);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_kRingFast, 0, 0, 2)
+    ZEND_ARG_INFO(0, h3Index)
+    ZEND_ARG_INFO(0, k)
+    ZEND_ARG_INFO(1, usedFallback)
+    ZEND_ARG_INFO(0, format)
+ZEND_END_ARG_INFO()
+
+PHP_FUNCTION(maxKringSize)
+{
+    zend_long k;
+    zend_long size;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &k) == FAILURE)
+    {
+        return;
+    }
+
+    size = maxKringSize(k);
+
+    RETURN_LONG(size);
+}
+
+PHP_FUNCTION(kRingDistances)
+{
+    zend_long indexed, k;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &k) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_check_k(k) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    int arr_count = maxKringSize(k);
+
+    H3Index *outs = (H3Index *)php_h3_arena_alloc(arr_count * sizeof(H3Index), 0);
+    int *distances = (int *)php_h3_arena_alloc(arr_count * sizeof(int), 0);
+    kRingDistances(indexed, k, outs, distances);
+
+    // fill both arrays in one pass, dropping the H3_NULL slots so they stay
+    // aligned
+    zval out_zvals, distance_zvals;
+    uint32_t count = 0;
+
+    php_h3_packed_array_init(&out_zvals, arr_count);
+    php_h3_packed_array_init(&distance_zvals, arr_count);
+
+    for (int i = 0; i < arr_count; i++)
+    {
+        if (outs[i] != 0)
+        {
+            php_h3_packed_array_set(&out_zvals, count, outs[i]);
+            php_h3_packed_array_set(&distance_zvals, count, distances[i]);
+            count++;
+        }
+    }
+
+    php_h3_packed_array_done(&out_zvals, count);
+    php_h3_packed_array_done(&distance_zvals, count);
+
+    array_init_size(return_value, 2);
+    add_index_zval(return_value, 0, &out_zvals);
+    add_index_zval(return_value, 1, &distance_zvals);
+
+    php_h3_arena_free(distances);
+    php_h3_arena_free(outs);
+}
+
+PHP_FUNCTION(hexRange)
+{
+    zend_long indexed, k, format = PHP_H3_FORMAT_ARRAY;
+    php_h3_output out;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll|l", &indexed, &k, &format) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_check_k(k) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    int arr_count = maxKringSize(k);
+
+    H3Index *outs = php_h3_output_init_ex(&out, format, arr_count, 0);
+    if (hexRange(indexed, k, outs) != 0)
+    {
+        php_h3_output_free(&out);
+        RETURN_FALSE;
+    }
+
+    php_h3_output_return(&out, arr_count, return_value);
+}
+
+PHP_FUNCTION(hexRangeDistances)
+{
+    zend_long indexed, k;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &k) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_check_k(k) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    int arr_count = maxKringSize(k);
+
+    H3Index *outs = (H3Index *)php_h3_arena_alloc(arr_count * sizeof(H3Index), 0);
+    int *distances = (int *)php_h3_arena_alloc(arr_count * sizeof(int), 0);
+    if (hexRangeDistances(indexed, k, outs, distances) != 0)
+    {
+        php_h3_arena_free(distances);
+        php_h3_arena_free(outs);
+        RETURN_FALSE;
+    }
+
+    zval out_zvals, distance_zvals;
+
+    php_h3_packed_array_init(&out_zvals, arr_count);
+    php_h3_packed_array_init(&distance_zvals, arr_count);
+
+    for (int i = 0; i < arr_count; i++)
+    {
+        php_h3_packed_array_set(&out_zvals, i, outs[i]);
+        php_h3_packed_array_set(&distance_zvals, i, distances[i]);
+    }
+
+    php_h3_packed_array_done(&out_zvals, arr_count);
+    php_h3_packed_array_done(&distance_zvals, arr_count);
+
+    array_init_size(return_value, 2);
+    add_index_zval(return_value, 0, &out_zvals);
+    add_index_zval(return_value, 1, &distance_zvals);
+
+    php_h3_arena_free(distances);
+    php_h3_arena_free(outs);
+}
+
+PHP_FUNCTION(hexRanges)
+{
+    zend_long k, format = PHP_H3_FORMAT_ARRAY;
+    zval *h3Set_zval;
+    php_h3_input in;
+    php_h3_output out;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "zl|l", &h3Set_zval, &k, &format) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_check_k(k) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    if (php_h3_input_init(&in, h3Set_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+    if (php_h3_input_check_int(&in) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    size_t arr_count = (size_t)maxKringSize(k) * in.length;
+
+    H3Index *outs = php_h3_output_init_ex(&out, format, arr_count, 0);
+    if (hexRanges(in.indexes, (int)in.length, k, outs) != 0)
+    {
+        php_h3_input_free(&in);
+        php_h3_output_free(&out);
+        RETURN_FALSE;
+    }
+
+    php_h3_input_free(&in);
+    php_h3_output_return(&out, arr_count, return_value);
+}
+
+PHP_FUNCTION(hexRing)
+{
+    zend_long indexed, k, format = PHP_H3_FORMAT_ARRAY;
+    php_h3_output out;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll|l", &indexed, &k, &format) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_check_k(k) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    int arr_count = k == 0 ? 1 : 6 * k;
+
+    H3Index *outs = php_h3_output_init_ex(&out, format, arr_count, 0);
+    if (hexRing(indexed, k, outs) != 0)
+    {
+        php_h3_output_free(&out);
+        RETURN_FALSE;
+    }
+
+    php_h3_output_return(&out, arr_count, return_value);
+}
+
+PHP_FUNCTION(h3Line)
+{
+    zend_long start, end, format = PHP_H3_FORMAT_ARRAY;
+    int size;
+    php_h3_output out;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll|l", &start, &end, &format) == FAILURE)
+    {
+        return;
+    }
+
+    size = h3LineSize(start, end);
+    if (size < 0)
+    {
+        RETURN_FALSE;
+    }
+
+    H3Index *outs = php_h3_output_init(&out, format, size);
+
+    if (h3Line(start, end, outs) != 0)
+    {
+        php_h3_output_free(&out);
+        RETURN_FALSE;
+    }
+
+    php_h3_output_return(&out, size, return_value);
+}
+
+PHP_FUNCTION(h3LineSize)
+{
+    zend_long start, end;
+    int size;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &start, &end) == FAILURE)
+    {
+        return;
+    }
+
+    size = h3LineSize(start, end);
+
+    if (size < 0)
+    {
+        RETURN_FALSE;
+    }
+    else
+    {
+        RETURN_LONG(size);
+    }
+}
+
+PHP_FUNCTION(h3Distance)
+{
+    zend_long origin, h3;
+    int distance;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &origin, &h3) == FAILURE)
+    {
+        return;
+    }
+
+    distance = h3Distance(origin, h3);
+
+    RETURN_LONG(distance);
+}
+
+/* {{{ batched grid distances
+ */
+// Below this many pairs a batch runs on the calling thread only
+#define PHP_H3_PAIRS_PARALLEL_MIN 65536
+
+// Pairs a worker takes at a time, so threads are not fed one pair at a time
+#define PHP_H3_PAIRS_CHUNK 4096
+
+typedef int (*php_h3_pair_metric)(H3Index origin, H3Index destination);
+
+typedef struct _php_h3_pairs
+{
+    php_h3_pair_metric metric;
+    const H3Index *origins;
+    H3Index origin;
+    const H3Index *destinations;
+    size_t count;
+    int32_t *results;
+} php_h3_pairs;
+
+static void php_h3_pairs_task(void *ctx, size_t index)
+{
+    php_h3_pairs *pairs = (php_h3_pairs *)ctx;
+    size_t end = MIN((index + 1) * PHP_H3_PAIRS_CHUNK, pairs->count);
+
+    for (size_t i = index * PHP_H3_PAIRS_CHUNK; i < end; i++)
+    {
+        int value = pairs->metric(pairs->origins != NULL ? pairs->origins[i] : pairs->origin, pairs->destinations[i]);
+
+        // libh3 reports pairs it cannot measure with different negative codes
+        pairs->results[i] = value < 0 ? -1 : value;
+    }
+}
+
+// Applies metric to every origin/destination pair and returns the results as
+// a packed string of native int32 values, -1 where a pair failed. origins is
+// either a single index measured against every destination, or an index set
+// of the same length as destinations.
+static void php_h3_pairs_impl(INTERNAL_FUNCTION_PARAMETERS, php_h3_pair_metric metric)
+{
+    zval *origins_zval, *destinations_zval;
+    zend_long threads = 1;
+    php_h3_input origins = {NULL, 0, 0}, destinations;
+    php_h3_pairs pairs;
+    zend_string *packed;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "zz|l", &origins_zval, &destinations_zval, &threads) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_input_init(&destinations, destinations_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    pairs.metric = metric;
+    pairs.origins = NULL;
+    pairs.origin = 0;
+    pairs.destinations = destinations.indexes;
+    pairs.count = destinations.length;
+
+    if (Z_TYPE_P(origins_zval) == IS_LONG)
+    {
+        pairs.origin = Z_LVAL_P(origins_zval);
+    }
+    else
+    {
+        if (php_h3_input_init(&origins, origins_zval) == FAILURE)
+        {
+            php_h3_input_free(&destinations);
+            RETURN_FALSE;
+        }
+        if (origins.length != destinations.length)
+        {
+            php_error_docref(NULL, E_WARNING, "Origins and destinations must have the same number of indexes");
+            php_h3_input_free(&origins);
+            php_h3_input_free(&destinations);
+            RETURN_FALSE;
+        }
+        pairs.origins = origins.indexes;
+    }
+
+    packed = zend_string_alloc(pairs.count * sizeof(int32_t), 0);
+    pairs.results = (int32_t *)ZSTR_VAL(packed);
+
+    size_t chunks = (pairs.count + PHP_H3_PAIRS_CHUNK - 1) / PHP_H3_PAIRS_CHUNK;
+    if (threads > 1 && pairs.count >= PHP_H3_PAIRS_PARALLEL_MIN)
+    {
+        php_h3_parallel_for(chunks, threads, php_h3_pairs_task, &pairs);
+    }
+    else
+    {
+        for (size_t i = 0; i < chunks; i++)
+        {
+            php_h3_pairs_task(&pairs, i);
+        }
+    }
+
+    php_h3_input_free(&origins);
+    php_h3_input_free(&destinations);
+
+    ZSTR_VAL(packed)[ZSTR_LEN(packed)] = '\0';
+    RETURN_NEW_STR(packed);
+}
+/* }}} */
+
+// h3Distance() over many pairs, see php_h3_pairs_impl(); read the result
+// with unpack('l*', ...).
+PHP_FUNCTION(h3DistanceBatch)
+{
+    php_h3_pairs_impl(INTERNAL_FUNCTION_PARAM_PASSTHRU, h3Distance);
+}
+
+// h3LineSize() over many pairs, see php_h3_pairs_impl().
+PHP_FUNCTION(h3LineSizeBatch)
+{
+    php_h3_pairs_impl(INTERNAL_FUNCTION_PARAM_PASSTHRU, h3LineSize);
+}
+
+//This function is experimental, and its output is not guaranteed to be compatible across different versions of H3.
+PHP_FUNCTION(experimentalH3ToLocalIj)
+{
+    zend_long origin, h3;
+    CoordIJ ij;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &origin, &h3) == FAILURE)
+    {
+        return;
+    }
+
+    if (experimentalH3ToLocalIj(origin, h3, &ij) != 0)
+    {
+        RETURN_FALSE;
+    }
+    else
+    {
+        array_init(return_value);
+        add_assoc_long(return_value, "i", ij.i);
+        add_assoc_long(return_value, "j", ij.j);
+    }
+}
+
+//This function is experimental, and its output is not guaranteed to be compatible across different versions of H3.
+PHP_FUNCTION(experimentalLocalIjToH3)
+{
+    zend_long origin;
+    CoordIJ ij;
+    zval *ij_zval;
+    H3Index out;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "la", &origin, &ij_zval) == FAILURE)
+    {
+        return;
+    }
+
+    ij.i = Z_LVAL_P(zend_hash_str_find(Z_ARRVAL_P(ij_zval), "i", 1));
+    ij.j = Z_LVAL_P(zend_hash_str_find(Z_ARRVAL_P(ij_zval), "j", 1));
+
+    if (experimentalLocalIjToH3(origin, &ij, &out) != 0)
+    {
+        RETURN_FALSE;
+    }
+    else
+    {
+        RETURN_LONG(out);
+    }
+}
+
+PHP_FUNCTION(h3ToParent)
+{
+    zend_long indexed;
+    int parentRes;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &parentRes) == FAILURE)
+    {
+        return;
+    }
+
+    H3Index h3Parent = h3ToParent(indexed, parentRes);
+
+    RETURN_LONG(h3Parent);
+}
+
+PHP_FUNCTION(h3ToChildren)
+{
+    zend_long indexed, childrenRes, format = PHP_H3_FORMAT_ARRAY;
+    php_h3_output out;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll|l", &indexed, &childrenRes, &format) == FAILURE)
+    {
+        return;
+    }
+
+    int childrenSize = maxH3ToChildrenSize(indexed, childrenRes);
+    H3Index *h3Childrens = php_h3_output_init(&out, format, childrenSize);
+    h3ToChildren(indexed, childrenRes, h3Childrens);
+
+    php_h3_output_return(&out, php_h3_trim_indexes(h3Childrens, childrenSize), return_value);
+}
+
+PHP_FUNCTION(maxH3ToChildrenSize)
+{
+    zend_long indexed, childrenRes;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &childrenRes) == FAILURE)
+    {
+        return;
+    }
+
+    int childrenSize = maxH3ToChildrenSize(indexed, childrenRes);
+
+    RETURN_LONG(childrenSize);
+}
+
+PHP_FUNCTION(h3ToCenterChild)
+{
+    zend_long indexed, childrenRes;
+    H3Index centerChild;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &childrenRes) == FAILURE)
+    {
+        return;
+    }
+
+    centerChild = h3ToCenterChild(indexed, childrenRes);
+
+    RETURN_LONG(centerChild);
+}
+
+PHP_FUNCTION(h3Compact)
+{
+    zval *compactedSet_zval;
+    zend_long format = PHP_H3_FORMAT_ARRAY;
+    php_h3_input in;
+    php_h3_output out;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "z|l", &compactedSet_zval, &format) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_input_init(&in, compactedSet_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+    if (php_h3_input_check_int(&in) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    int length = (int)in.length;
+    H3Index *outs = php_h3_output_init(&out, format, length);
+    if (compact(in.indexes, outs, length) != 0)
+    {
+        php_h3_input_free(&in);
+        php_h3_output_free(&out);
+        RETURN_FALSE;
+    }
+
+    php_h3_input_free(&in);
+
+    int count = 0;
+    while (count < length && outs[count] != 0)
+    {
+        count++;
+    }
+
+    php_h3_output_return(&out, count, return_value);
+}
+
+PHP_FUNCTION(uncompact)
+{
+    zend_long uncompactRes, format = PHP_H3_FORMAT_ARRAY;
+    zval *compactedSet_zval;
+    php_h3_input in;
+    php_h3_output out;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "zl|l", &compactedSet_zval, &uncompactRes, &format) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_input_init(&in, compactedSet_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+    if (php_h3_input_check_int(&in) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    int uncompactedSize = maxUncompactSize(in.indexes, (int)in.length, uncompactRes);
+    if (uncompactedSize < 0)
+    {
+        php_h3_input_free(&in);
+        RETURN_FALSE;
+    }
+
+    H3Index *outs = php_h3_output_init(&out, format, uncompactedSize);
+    if (uncompact(in.indexes, (int)in.length, outs, uncompactedSize, uncompactRes) != 0)
+    {
+        php_h3_input_free(&in);
+        php_h3_output_free(&out);
+        RETURN_FALSE;
+    }
+
+    php_h3_input_free(&in);
+    php_h3_output_return(&out, php_h3_trim_indexes(outs, uncompactedSize), return_value);
+}
+
+PHP_FUNCTION(maxUncompactSize)
+{
+    zend_long uncompactRes;
+    zval *compactedSet_zval;
+    php_h3_input in;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "zl", &compactedSet_zval, &uncompactRes) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_input_init(&in, compactedSet_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+    if (php_h3_input_check_int(&in) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    int uncompactedSize = maxUncompactSize(in.indexes, (int)in.length, uncompactRes);
+
+    php_h3_input_free(&in);
+
+    RETURN_LONG(uncompactedSize);
+}
+
+/* {{{ hierarchy-aware set algebra
+ */
+// Every cell covers a contiguous range of its res 15 descendants when indexes
+// are ordered by base cell and digits. Ranges of two cells are either nested
+// or disjoint, so sets can be compared by sorting and merging these ranges.
+typedef struct _php_h3_range
+{
+    H3Index lo;
+    H3Index hi;
+    H3Index cell;
+} php_h3_range;
+
+typedef struct _php_h3_vector
+{
+    H3Index *indexes;
+    size_t count;
+    size_t capacity;
+} php_h3_vector;
+
+static void php_h3_vector_push(php_h3_vector *vector, H3Index index)
+{
+    if (vector->count == vector->capacity)
+    {
+        vector->capacity = vector->capacity < 16 ? 16 : vector->capacity * 2;
+        vector->indexes = (H3Index *)realloc(vector->indexes, vector->capacity * sizeof(H3Index));
+    }
+    vector->indexes[vector->count++] = index;
+}
+
+static void php_h3_range_of(H3Index cell, php_h3_range *range)
+{
+    int res = (int)((cell >> 52) & 0xF);
+    H3Index key = cell & ((1ULL << 52) - 1);
+    H3Index tail = res == 15 ? 0 : (1ULL << (3 * (15 - res))) - 1;
+
+    range->lo = key & ~tail;
+    range->hi = key | tail;
+    range->cell = cell;
+}
+
+static int php_h3_range_compare(const void *a, const void *b)
+{
+    const php_h3_range *ra = (const php_h3_range *)a;
+    const php_h3_range *rb = (const php_h3_range *)b;
+
+    if (ra->lo != rb->lo)
+    {
+        return ra->lo < rb->lo ? -1 : 1;
+    }
+    // the coarser cell sorts first so it absorbs its descendants
+    if (ra->hi != rb->hi)
+    {
+        return ra->hi > rb->hi ? -1 : 1;
+    }
+    return 0;
+}
+
+// Sorts the ranges of the given indexes and drops H3_NULL entries, duplicates
+// and cells already covered by an ancestor in the same set. Returns the new
+// number of ranges.
+static size_t php_h3_ranges_normalize(php_h3_range *ranges, size_t count)
+{
+    size_t kept = 0;
+
+    qsort(ranges, count, sizeof(php_h3_range), php_h3_range_compare);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (ranges[i].cell == 0)
+        {
+            continue;
+        }
+        if (kept > 0 && ranges[i].lo <= ranges[kept - 1].hi)
+        {
+            continue;
+        }
+        ranges[kept++] = ranges[i];
+    }
+
+    return kept;
+}
+
+static php_h3_range *php_h3_ranges_from_indexes(const H3Index *indexes, size_t count, php_h3_range *ranges)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        php_h3_range_of(indexes[i], &ranges[i]);
+    }
+    return ranges;
+}
+
+// Replaces complete groups of siblings by their parent until no group is
+// left, keeping the ranges sorted. Returns the new number of ranges.
+static size_t php_h3_ranges_compact(php_h3_range *ranges, size_t count)
+{
+    int changed = 1;
+
+    while (changed)
+    {
+        size_t kept = 0;
+        changed = 0;
+
+        for (size_t i = 0; i < count;)
+        {
+            int res = h3GetResolution(ranges[i].cell);
+
+            if (res > 0)
+            {
+                H3Index parent = h3ToParent(ranges[i].cell, res - 1);
+                size_t siblings = php_h3_is_pentagon(parent) ? 6 : 7;
+                size_t j = i + 1;
+
+                while (j < count && j - i < siblings && h3GetResolution(ranges[j].cell) == res && h3ToParent(ranges[j].cell, res - 1) == parent)
+                {
+                    j++;
+                }
+
+                if (j - i == siblings)
+                {
+                    php_h3_range_of(parent, &ranges[kept++]);
+                    i = j;
+                    changed = 1;
+                    continue;
+                }
+            }
+
+            ranges[kept++] = ranges[i++];
+        }
+
+        count = kept;
+    }
+
+    return count;
+}
+
+static void php_h3_ranges_union(const php_h3_range *a, size_t na, const php_h3_range *b, size_t nb, php_h3_vector *out)
+{
+    php_h3_range *ranges = (php_h3_range *)calloc(na + nb + 1, sizeof(php_h3_range));
+    size_t count;
+
+    memcpy(ranges, a, na * sizeof(php_h3_range));
+    memcpy(ranges + na, b, nb * sizeof(php_h3_range));
+    count = php_h3_ranges_normalize(ranges, na + nb);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        php_h3_vector_push(out, ranges[i].cell);
+    }
+
+    free(ranges);
+}
+
+static void php_h3_ranges_intersection(const php_h3_range *a, size_t na, const php_h3_range *b, size_t nb, php_h3_vector *out)
+{
+    size_t i = 0, j = 0;
+
+    while (i < na && j < nb)
+    {
+        if (a[i].hi < b[j].lo)
+        {
+            i++;
+        }
+        else if (b[j].hi < a[i].lo)
+        {
+            j++;
+        }
+        else if (a[i].lo <= b[j].lo && b[j].hi <= a[i].hi)
+        {
+            // overlapping ranges are nested, keep the finer cell
+            php_h3_vector_push(out, b[j++].cell);
+        }
+        else
+        {
+            php_h3_vector_push(out, a[i++].cell);
+        }
+    }
+}
+
+// Emits the parts of cell not covered by b, splitting it into children only
+// where some cell of b lies strictly inside it.
+static void php_h3_difference_cell(H3Index cell, const php_h3_range *b, size_t nb, php_h3_vector *out)
+{
+    php_h3_range range;
+    size_t low = 0, high = nb;
+
+    php_h3_range_of(cell, &range);
+
+    // b is sorted and disjoint, so its hi values are sorted as well
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (b[mid].hi < range.lo)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    if (low == nb || b[low].lo > range.hi)
+    {
+        php_h3_vector_push(out, cell);
+        return;
+    }
+
+    if (b[low].lo <= range.lo && range.hi <= b[low].hi)
+    {
+        return;
+    }
+
+    H3Index children[7] = {0};
+    h3ToChildren(cell, h3GetResolution(cell) + 1, children);
+
+    for (int i = 0; i < 7; i++)
+    {
+        if (children[i] != 0)
+        {
+            php_h3_difference_cell(children[i], b, nb, out);
+        }
+    }
+}
+
+static void php_h3_ranges_difference(const php_h3_range *a, size_t na, const php_h3_range *b, size_t nb, php_h3_vector *out)
+{
+    for (size_t i = 0; i < na; i++)
+    {
+        php_h3_difference_cell(a[i].cell, b, nb, out);
+    }
+}
+
+typedef void (*php_h3_set_operation)(const php_h3_range *a, size_t na, const php_h3_range *b, size_t nb, php_h3_vector *out);
+
+static void php_h3_set_operation_impl(INTERNAL_FUNCTION_PARAMETERS, php_h3_set_operation operation)
+{
+    zval *a_zval, *b_zval;
+    zend_bool compact_result = 0;
+    zend_long format = PHP_H3_FORMAT_ARRAY;
+    php_h3_input a, b;
+    php_h3_output out;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "zz|bl", &a_zval, &b_zval, &compact_result, &format) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_input_init(&a, a_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+    if (php_h3_input_init(&b, b_zval) == FAILURE)
+    {
+        php_h3_input_free(&a);
+        RETURN_FALSE;
+    }
+
+    php_h3_range *a_ranges = (php_h3_range *)calloc(a.length + 1, sizeof(php_h3_range));
+    php_h3_range *b_ranges = (php_h3_range *)calloc(b.length + 1, sizeof(php_h3_range));
+    size_t na = php_h3_ranges_normalize(php_h3_ranges_from_indexes(a.indexes, a.length, a_ranges), a.length);
+    size_t nb = php_h3_ranges_normalize(php_h3_ranges_from_indexes(b.indexes, b.length, b_ranges), b.length);
+
+    php_h3_input_free(&a);
+    php_h3_input_free(&b);
+
+    php_h3_vector result = {NULL, 0, 0};
+    operation(a_ranges, na, b_ranges, nb, &result);
+
+    free(a_ranges);
+    free(b_ranges);
+
+    if (compact_result && result.count > 0)
+    {
+        php_h3_range *ranges = (php_h3_range *)calloc(result.count, sizeof(php_h3_range));
+
+        php_h3_ranges_from_indexes(result.indexes, result.count, ranges);
+        result.count = php_h3_ranges_compact(ranges, result.count);
+        for (size_t i = 0; i < result.count; i++)
+        {
+            result.indexes[i] = ranges[i].cell;
+        }
+
+        free(ranges);
+    }
+
+    H3Index *outs = php_h3_output_init(&out, format, result.count);
+    if (result.count > 0)
+    {
+        memcpy(outs, result.indexes, result.count * sizeof(H3Index));
+    }
+    free(result.indexes);
+
+    php_h3_output_return(&out, result.count, return_value);
+}
+/* }}} */
+
+PHP_FUNCTION(h3SetUnion)
+{
+    php_h3_set_operation_impl(INTERNAL_FUNCTION_PARAM_PASSTHRU, php_h3_ranges_union);
+}
+
+PHP_FUNCTION(h3SetIntersection)
+{
+    php_h3_set_operation_impl(INTERNAL_FUNCTION_PARAM_PASSTHRU, php_h3_ranges_intersection);
+}
+
+PHP_FUNCTION(h3SetDifference)
+{
+    php_h3_set_operation_impl(INTERNAL_FUNCTION_PARAM_PASSTHRU, php_h3_ranges_difference);
+}
+
+/* {{{ hierarchical rollup
+ */
+typedef struct _php_h3_rollup_entry
+{
+    H3Index key;
+    H3Index cell;
+    double value;
+} php_h3_rollup_entry;
+
+// Per-parent aggregates of one requested resolution, written in place: the
+// last slot is the parent currently being accumulated.
+typedef struct _php_h3_rollup_level
+{
+    int res;
+    size_t count;
+    php_h3_output cells_out;
+    php_h3_output counts_out;
+    H3Index *cells;
+    H3Index *counts;
+    zend_string *sums;
+    zend_string *mins;
+    zend_string *maxs;
+} php_h3_rollup_level;
+
+// h3ToParent() without validation: swap the resolution field and set the
+// digits below it to 7, which unused digits already are.
+static inline H3Index php_h3_parent_bits(H3Index cell, int res)
+{
+    return (cell & ~((H3Index)0xF << 52)) | ((H3Index)res << 52) | (((H3Index)1 << (3 * (15 - res))) - 1);
+}
+
+static int php_h3_rollup_entry_compare(const void *a, const void *b)
+{
+    H3Index ka = ((const php_h3_rollup_entry *)a)->key;
+    H3Index kb = ((const php_h3_rollup_entry *)b)->key;
+
+    return ka < kb ? -1 : (ka > kb ? 1 : 0);
+}
+
+// Reads an array of numbers or a packed string of native float64 values.
+static double *php_h3_doubles_from_zval(zval *values_zval, size_t *count)
+{
+    double *values;
+
+    if (Z_TYPE_P(values_zval) == IS_STRING)
+    {
+        if (Z_STRLEN_P(values_zval) % sizeof(double) != 0)
+        {
+            php_error_docref(NULL, E_WARNING, "Packed values must be a sequence of float64 values");
+            return NULL;
+        }
+
+        *count = Z_STRLEN_P(values_zval) / sizeof(double);
+        values = (double *)calloc(*count + 1, sizeof(double));
+        memcpy(values, Z_STRVAL_P(values_zval), Z_STRLEN_P(values_zval));
+        return values;
+    }
+
+    if (Z_TYPE_P(values_zval) == IS_ARRAY)
+    {
+        zval *value_zval;
+        size_t i = 0;
+
+        *count = zend_hash_num_elements(Z_ARRVAL_P(values_zval));
+        values = (double *)calloc(*count + 1, sizeof(double));
+
+        ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(values_zval), value_zval)
+        {
+            values[i++] = zval_get_double(value_zval);
+        }
+        ZEND_HASH_FOREACH_END();
+
+        return values;
+    }
+
+    php_error_docref(NULL, E_WARNING, "Values must be given as an array or a packed float64 string");
+    return NULL;
+}
+/* }}} */
+
+// Aggregates values of fine cells into their parents at every requested
+// resolution in one pass over the cells sorted by position in the hierarchy.
+// Returns [res => ["cells" => packed uint64, "count" => packed uint64,
+// "sum"/"min"/"max" => packed float64]], each sorted by parent index.
+PHP_FUNCTION(h3Rollup)
+{
+    zval *h3Set_zval, *values_zval = NULL, *resolutions_zval, *res_zval;
+    php_h3_input in;
+    double *values = NULL;
+    size_t values_count = 0, levels_count = 0;
+    php_h3_rollup_level *levels;
+    php_h3_rollup_entry *entries;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "zz!a", &h3Set_zval, &values_zval, &resolutions_zval) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_input_init(&in, h3Set_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    if (values_zval != NULL)
+    {
+        values = php_h3_doubles_from_zval(values_zval, &values_count);
+        if (values == NULL || values_count != in.length)
+        {
+            if (values != NULL)
+            {
+                php_error_docref(NULL, E_WARNING, "Cells and values must have the same number of elements");
+            }
+            free(values);
+            php_h3_input_free(&in);
+            RETURN_FALSE;
+        }
+    }
+
+    levels = (php_h3_rollup_level *)calloc(zend_hash_num_elements(Z_ARRVAL_P(resolutions_zval)) + 1, sizeof(php_h3_rollup_level));
+
+    ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(resolutions_zval), res_zval)
+    {
+        zend_long res = zval_get_long(res_zval);
+
+        if (res < 0 || res > MAX_H3_RES)
+        {
+            php_error_docref(NULL, E_WARNING, "Resolutions must be between 0 and %d", MAX_H3_RES);
+            for (size_t i = 0; i < levels_count; i++)
+            {
+                php_h3_output_free(&levels[i].cells_out);
+                php_h3_output_free(&levels[i].counts_out);
+                zend_string_free(levels[i].sums);
+                zend_string_free(levels[i].mins);
+                zend_string_free(levels[i].maxs);
+            }
+            free(levels);
+            free(values);
+            php_h3_input_free(&in);
+            RETURN_FALSE;
+        }
+
+        php_h3_rollup_level *level = &levels[levels_count++];
+        level->res = (int)res;
+        level->cells = php_h3_output_init(&level->cells_out, PHP_H3_FORMAT_PACKED, in.length);
+        level->counts = php_h3_output_init(&level->counts_out, PHP_H3_FORMAT_PACKED, in.length);
+        level->sums = zend_string_alloc(in.length * sizeof(double), 0);
+        level->mins = zend_string_alloc(in.length * sizeof(double), 0);
+        level->maxs = zend_string_alloc(in.length * sizeof(double), 0);
+    }
+    ZEND_HASH_FOREACH_END();
+
+    // children of a parent share its leading digits, so sorting by base cell
+    // and digits makes every parent's cells contiguous at all resolutions
+    entries = (php_h3_rollup_entry *)calloc(in.length + 1, sizeof(php_h3_rollup_entry));
+    size_t entries_count = 0;
+    for (size_t i = 0; i < in.length; i++)
+    {
+        if (in.indexes[i] == 0)
+        {
+            continue;
+        }
+        entries[entries_count].key = in.indexes[i] & (((H3Index)1 << 52) - 1);
+        entries[entries_count].cell = in.indexes[i];
+        entries[entries_count].value = values != NULL ? values[i] : 1.0;
+        entries_count++;
+    }
+    qsort(entries, entries_count, sizeof(php_h3_rollup_entry), php_h3_rollup_entry_compare);
+
+    php_h3_input_free(&in);
+    free(values);
+
+    for (size_t i = 0; i < entries_count; i++)
+    {
+        const php_h3_rollup_entry *entry = &entries[i];
+
+        for (size_t l = 0; l < levels_count; l++)
+        {
+            php_h3_rollup_level *level = &levels[l];
+            double *sums = (double *)ZSTR_VAL(level->sums);
+            double *mins = (double *)ZSTR_VAL(level->mins);
+            double *maxs = (double *)ZSTR_VAL(level->maxs);
+
+            if (level->res > (int)((entry->cell >> 52) & 0xF))
+            {
+                continue;
+            }
+
+            H3Index parent = php_h3_parent_bits(entry->cell, level->res);
+            size_t slot = level->count - 1;
+
+            if (level->count == 0 || level->cells[slot] != parent)
+            {
+                slot = level->count++;
+                level->cells[slot] = parent;
+                level->counts[slot] = 0;
+                sums[slot] = 0;
+                mins[slot] = entry->value;
+                maxs[slot] = entry->value;
+            }
+
+            level->counts[slot]++;
+            sums[slot] += entry->value;
+            mins[slot] = MIN(mins[slot], entry->value);
+            maxs[slot] = MAX(maxs[slot], entry->value);
+        }
+    }
+
+    free(entries);
+
+    array_init_size(return_value, levels_count);
+
+    for (size_t l = 0; l < levels_count; l++)
+    {
+        php_h3_rollup_level *level = &levels[l];
+        zval level_zval, cells_zval, counts_zval;
+
+        php_h3_output_return(&level->cells_out, level->count, &cells_zval);
+        php_h3_output_return(&level->counts_out, level->count, &counts_zval);
+        level->sums = zend_string_truncate(level->sums, level->count * sizeof(double), 0);
+        level->mins = zend_string_truncate(level->mins, level->count * sizeof(double), 0);
+        level->maxs = zend_string_truncate(level->maxs, level->count * sizeof(double), 0);
+        ZSTR_VAL(level->sums)[ZSTR_LEN(level->sums)] = '\0';
+        ZSTR_VAL(level->mins)[ZSTR_LEN(level->mins)] = '\0';
+        ZSTR_VAL(level->maxs)[ZSTR_LEN(level->maxs)] = '\0';
+
+        array_init_size(&level_zval, 5);
+        add_assoc_zval(&level_zval, "cells", &cells_zval);
+        add_assoc_zval(&level_zval, "count", &counts_zval);
+        add_assoc_str(&level_zval, "sum", level->sums);
+        add_assoc_str(&level_zval, "min", level->mins);
+        add_assoc_str(&level_zval, "max", level->maxs);
+
+        // a resolution listed twice keeps the last copy
+        zend_hash_index_update(Z_ARRVAL_P(return_value), level->res, &level_zval);
+    }
+
+    free(levels);
+}
+
+// Returns the adjacency of a cell set in compressed sparse row form: the
+// neighbours inside the set of cells[i] are the rows listed in
+// neighbors[offsets[i]] up to neighbors[offsets[i + 1]]. cells, offsets and
+// neighbors are packed uint64 strings; lengths, when asked for, is a packed
+// float64 string with the exactEdgeLengthM() of every directed edge.
+PHP_FUNCTION(h3SetToAdjacency)
+{
+    zval *h3Set_zval;
+    zend_bool with_lengths = 0;
+    php_h3_input in;
+    php_h3_cell_map rows = {0};
+    php_h3_output cells_out, offsets_out, neighbors_out;
+    zend_string *lengths = NULL;
+    size_t count = 0, edges = 0;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "z|b", &h3Set_zval, &with_lengths) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_input_init(&in, h3Set_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    // row numbers of the distinct cells, looked up through the H3CellMap table
+    rows.type = PHP_H3_CELL_MAP_INT;
+    H3Index *cells = php_h3_output_init(&cells_out, PHP_H3_FORMAT_PACKED, in.length);
+    for (size_t i = 0; i < in.length; i++)
+    {
+        if (in.indexes[i] == 0 || php_h3_cell_map_find(&rows, in.indexes[i]) != NULL)
+        {
+            continue;
+        }
+        php_h3_cell_map_upsert(&rows, in.indexes[i])->l = (zend_long)count;
+        cells[count++] = in.indexes[i];
+    }
+    php_h3_input_free(&in);
+
+    // every cell has at most 6 neighbours
+    H3Index *offsets = php_h3_output_init(&offsets_out, PHP_H3_FORMAT_PACKED, count + 1);
+    H3Index *neighbors = php_h3_output_init(&neighbors_out, PHP_H3_FORMAT_PACKED, count * 6);
+    double *meters = NULL;
+    if (with_lengths)
+    {
+        lengths = zend_string_alloc(count * 6 * sizeof(double), 0);
+        meters = (double *)ZSTR_VAL(lengths);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        H3Index cell_edges[6] = {0};
+
+        offsets[i] = edges;
+        getH3UnidirectionalEdgesFromHexagon(cells[i], cell_edges);
+
+        for (int e = 0; e < 6; e++)
+        {
+            php_h3_cell_value *row;
+
+            if (cell_edges[e] == 0 || (row = php_h3_cell_map_find(&rows, getDestinationH3IndexFromUnidirectionalEdge(cell_edges[e]))) == NULL)
+            {
+                continue;
+            }
+
+            if (meters != NULL)
+            {
+                meters[edges] = exactEdgeLengthM(cell_edges[e]);
+            }
+            neighbors[edges++] = (H3Index)row->l;
+        }
+    }
+    offsets[count] = edges;
+
+    if (rows.keys != NULL)
+    {
+        efree(rows.keys);
+        efree(rows.values);
+    }
+
+    zval cells_zval, offsets_zval, neighbors_zval;
+
+    php_h3_output_return(&cells_out, count, &cells_zval);
+    php_h3_output_return(&offsets_out, count + 1, &offsets_zval);
+    php_h3_output_return(&neighbors_out, edges, &neighbors_zval);
+
+    array_init_size(return_value, 4);
+    add_assoc_zval(return_value, "cells", &cells_zval);
+    add_assoc_zval(return_value, "offsets", &offsets_zval);
+    add_assoc_zval(return_value, "neighbors", &neighbors_zval);
+
+    if (lengths != NULL)
+    {
+        lengths = zend_string_truncate(lengths, edges * sizeof(double), 0);
+        ZSTR_VAL(lengths)[ZSTR_LEN(lengths)] = '\0';
+        add_assoc_str(return_value, "lengths", lengths);
+    }
+}
+
+PHP_FUNCTION(h3IndexesAreNeighbors)
+{
+    zend_long origin, destination;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &origin, &destination) == FAILURE)
+    {
+        return;
+    }
+
+    if (h3IndexesAreNeighbors(origin, destination) == 1)
+    {
+        RETURN_TRUE;
+    }
+    else
+    {
+        RETURN_FALSE;
+    }
+}
+
+PHP_FUNCTION(getH3UnidirectionalEdge)
+{
+    zend_long origin, destination;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &origin, &destination) == FAILURE)
+    {
+        return;
+    }
+
+    H3Index index = getH3UnidirectionalEdge(origin, destination);
+    if (index == 0)
+    {
+        RETURN_FALSE;
+    }
+
+    RETURN_LONG(index);
+}
+
+PHP_FUNCTION(h3UnidirectionalEdgeIsValid)
+{
+    zend_long edge;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    {
+        return;
+    }
+
+    if (h3UnidirectionalEdgeIsValid(edge) == 1)
+    {
+        RETURN_TRUE;
+    }
+    else
+    {
+        RETURN_FALSE;
+    }
+}
+
+PHP_FUNCTION(getOriginH3IndexFromUnidirectionalEdge)
+{
+    zend_long edge;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    {
+        return;
+    }
+
+    H3Index index = getOriginH3IndexFromUnidirectionalEdge(edge);
+
+    RETURN_LONG(index);
+}
+
+PHP_FUNCTION(getDestinationH3IndexFromUnidirectionalEdge)
+{
+    zend_long edge;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    {
+        return;
+    }
+
+    H3Index index = getDestinationH3IndexFromUnidirectionalEdge(edge);
+
+    RETURN_LONG(index);
+}
+
+PHP_FUNCTION(getH3IndexesFromUnidirectionalEdge)
+{
+    zend_long edge;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    {
+        return;
+    }
+
+    H3Index originDestination[2];
+    getH3IndexesFromUnidirectionalEdge(edge, originDestination);
+
+    php_h3_array_from_indexes(return_value, originDestination, 2);
+}
+
+PHP_FUNCTION(getH3UnidirectionalEdgesFromHexagon)
+{
+    zend_long edge;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    {
+        return;
+    }
+
+    H3Index edges[6];
+    getH3UnidirectionalEdgesFromHexagon(edge, edges);
+
+    php_h3_array_from_indexes(return_value, edges, 6);
+}
+
+PHP_FUNCTION(getH3UnidirectionalEdgeBoundary)
+{
+    zend_long edge;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    {
+        return;
+    }
+
+    // Get the vertices of the H3 index.
+    GeoBoundary boundary;
+    getH3UnidirectionalEdgeBoundary(edge, &boundary);
+
+    array_init_size(return_value, boundary.numVerts);
+    // Indexes can have different number of vertices under some cases,
+    // which is why boundary.numVerts is needed.
+    for (int v = 0; v < boundary.numVerts; v++)
+    {
+        double lat, lon;
+
+        lat = radsToDegs(boundary.verts[v].lat);
+        lon = radsToDegs(boundary.verts[v].lon);
+
+        zval lat_lon_arr;
+        array_init_size(&lat_lon_arr, 2);
+
+        add_assoc_double(&lat_lon_arr, "lat", lat);
+        add_assoc_double(&lat_lon_arr, "lon", lon);
+
+        add_index_zval(return_value, v, &lat_lon_arr);
+    }
+}
+
+/* {{{ polygon helpers
+ */
+static int php_h3_geofence_from_zval(zval *loop_zval, Geofence *geofence)
+{
+    zval *vert_zval;
+    int i = 0;
+
+    geofence->numVerts = 0;
+    geofence->verts = NULL;
+
+    if (loop_zval == NULL || Z_TYPE_P(loop_zval) != IS_ARRAY)
+    {
+        php_error_docref(NULL, E_WARNING, "Geofences must be arrays of lat/lon vertices");
+        return FAILURE;
+    }
+
+    int verts_num = zend_hash_num_elements(Z_ARRVAL_P(loop_zval));
+    GeoCoord *verts = (GeoCoord *)calloc(verts_num + 1, sizeof(GeoCoord));
+
+    ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(loop_zval), vert_zval)
+    {
+        zval *lat_zval, *lon_zval;
+
+        ZVAL_DEREF(vert_zval);
+        if (Z_TYPE_P(vert_zval) != IS_ARRAY || (lat_zval = zend_hash_str_find(Z_ARRVAL_P(vert_zval), "lat", 3)) == NULL || (lon_zval = zend_hash_str_find(Z_ARRVAL_P(vert_zval), "lon", 3)) == NULL)
+        {
+            php_error_docref(NULL, E_WARNING, "Geofence vertices must be arrays with lat and lon keys");
+            free(verts);
+            return FAILURE;
+        }
+
+        verts[i].lat = degsToRads(zval_get_double(lat_zval));
+        verts[i].lon = degsToRads(zval_get_double(lon_zval));
+        i++;
+    }
+    ZEND_HASH_FOREACH_END();
+
+    geofence->numVerts = verts_num;
+    geofence->verts = verts;
+
+    return SUCCESS;
+}
+
+static void php_h3_geopolygon_free(GeoPolygon *geopolygon)
+{
+    free(geopolygon->geofence.verts);
+
+    for (int i = 0; i < geopolygon->numHoles; i++)
+    {
+        free(geopolygon->holes[i].verts);
+    }
+    free(geopolygon->holes);
+
+    geopolygon->geofence.verts = NULL;
+    geopolygon->holes = NULL;
+    geopolygon->numHoles = 0;
+}
+
+// Parses a ["geofence" => [...], "holes" => [[...], ...]] array, converting
+// every vertex to radians. The polygon must be released with php_h3_geopolygon_free.
+static int php_h3_geopolygon_from_zval(zval *geopolygon_zval, GeoPolygon *geopolygon)
+{
+    zval *geofence_zval = zend_hash_str_find(Z_ARRVAL_P(geopolygon_zval), "geofence", 8);
+    zval *holes_zval = zend_hash_str_find(Z_ARRVAL_P(geopolygon_zval), "holes", 5);
+
+    geopolygon->numHoles = 0;
+    geopolygon->holes = NULL;
+
+    if (php_h3_geofence_from_zval(geofence_zval, &geopolygon->geofence) == FAILURE)
+    {
+        return FAILURE;
+    }
+
+    if (holes_zval == NULL || Z_TYPE_P(holes_zval) != IS_ARRAY)
+    {
+        return SUCCESS;
+    }
+
+    zval *hole_zval;
+    geopolygon->holes = (Geofence *)calloc(zend_hash_num_elements(Z_ARRVAL_P(holes_zval)) + 1, sizeof(Geofence));
+
+    ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(holes_zval), hole_zval)
+    {
+        ZVAL_DEREF(hole_zval);
+        if (php_h3_geofence_from_zval(hole_zval, &geopolygon->holes[geopolygon->numHoles]) == FAILURE)
+        {
+            php_h3_geopolygon_free(geopolygon);
+            return FAILURE;
+        }
+        geopolygon->numHoles++;
+    }
+    ZEND_HASH_FOREACH_END();
+
+    return SUCCESS;
+}
+/* }}} */
+
+/* {{{ H3Polygon storage
+ */
+// Bounding box of a loop in radians, computed like libh3 does for polyfill:
+// east < west marks a loop that crosses the antimeridian.
+typedef struct _php_h3_bbox
+{
+    double north;
+    double south;
+    double east;
+    double west;
+} php_h3_bbox;
+
+// A polygon parsed and converted to radians once, with the bounding box of
+// every loop (geofence first, then holes) precomputed for containment tests.
+typedef struct _php_h3_polygon
+{
+    GeoPolygon geopolygon;
+    php_h3_bbox *bboxes;
+    zend_object std;
+} php_h3_polygon;
+
+static zend_class_entry *php_h3_polygon_ce;
+static zend_object_handlers php_h3_polygon_handlers;
+
+static inline php_h3_polygon *php_h3_polygon_from_obj(zend_object *obj)
+{
+    return (php_h3_polygon *)((char *)(obj)-XtOffsetOf(php_h3_polygon, std));
+}
+
+#define Z_H3_POLYGON_P(zv) php_h3_polygon_from_obj(Z_OBJ_P((zv)))
+
+#define PHP_H3_NORMALIZE_LON(lon, transmeridian) ((transmeridian) && (lon) < 0 ? (lon) + 2 * M_PI : (lon))
+
+static void php_h3_bbox_from_geofence(const Geofence *geofence, php_h3_bbox *bbox)
+{
+    double min_pos_lon = DBL_MAX, max_neg_lon = -DBL_MAX;
+    int transmeridian = 0;
+
+    if (geofence->numVerts == 0)
+    {
+        memset(bbox, 0, sizeof(php_h3_bbox));
+        return;
+    }
+
+    bbox->north = -DBL_MAX;
+    bbox->south = DBL_MAX;
+    bbox->east = -DBL_MAX;
+    bbox->west = DBL_MAX;
+
+    for (int i = 0; i < geofence->numVerts; i++)
+    {
+        const GeoCoord *coord = &geofence->verts[i];
+        const GeoCoord *next = &geofence->verts[(i + 1) % geofence->numVerts];
+
+        bbox->north = MAX(bbox->north, coord->lat);
+        bbox->south = MIN(bbox->south, coord->lat);
+        bbox->east = MAX(bbox->east, coord->lon);
+        bbox->west = MIN(bbox->west, coord->lon);
+
+        if (coord->lon > 0 && coord->lon < min_pos_lon)
+        {
+            min_pos_lon = coord->lon;
+        }
+        if (coord->lon < 0 && coord->lon > max_neg_lon)
+        {
+            max_neg_lon = coord->lon;
+        }
+        if (fabs(coord->lon - next->lon) > M_PI)
+        {
+            transmeridian = 1;
+        }
+    }
+
+    if (transmeridian)
+    {
+        bbox->east = max_neg_lon;
+        bbox->west = min_pos_lon;
+    }
+}
+
+// Ray casting with the same edge and antimeridian rules as libh3, so that a
+// point is inside exactly when polyfill would include a cell centered on it.
+static int php_h3_geofence_contains(const Geofence *geofence, const php_h3_bbox *bbox, const GeoCoord *coord)
+{
+    int transmeridian = bbox->east < bbox->west;
+    int contains = 0;
+    double lat = coord->lat;
+    double lon = PHP_H3_NORMALIZE_LON(coord->lon, transmeridian);
+
+    if (lat < bbox->south || lat > bbox->north)
+    {
+        return 0;
+    }
+    if (transmeridian ? (coord->lon < bbox->west && coord->lon > bbox->east) : (coord->lon < bbox->west || coord->lon > bbox->east))
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < geofence->numVerts; i++)
+    {
+        GeoCoord a = geofence->verts[i];
+        GeoCoord b = geofence->verts[(i + 1) % geofence->numVerts];
+
+        if (a.lat > b.lat)
+        {
+            GeoCoord tmp = a;
+            a = b;
+            b = tmp;
+        }
+
+        if (lat == a.lat || lat == b.lat)
+        {
+            lat += DBL_EPSILON;
+        }
+        if (lat < a.lat || lat > b.lat)
+        {
+            continue;
+        }
+
+        double a_lon = PHP_H3_NORMALIZE_LON(a.lon, transmeridian);
+        double b_lon = PHP_H3_NORMALIZE_LON(b.lon, transmeridian);
+
+        if (a_lon == lon || b_lon == lon)
+        {
+            lon -= DBL_EPSILON;
+        }
+
+        double ratio = (lat - a.lat) / (b.lat - a.lat);
+        double test_lon = PHP_H3_NORMALIZE_LON(a_lon + (b_lon - a_lon) * ratio, transmeridian);
+
+        if (test_lon > lon)
+        {
+            contains = !contains;
+        }
+    }
+
+    return contains;
+}
+
+static int php_h3_polygon_contains(const php_h3_polygon *polygon, const GeoCoord *coord)
+{
+    if (!php_h3_geofence_contains(&polygon->geopolygon.geofence, &polygon->bboxes[0], coord))
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < polygon->geopolygon.numHoles; i++)
+    {
+        if (php_h3_geofence_contains(&polygon->geopolygon.holes[i], &polygon->bboxes[i + 1], coord))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static zend_object *php_h3_polygon_create(zend_class_entry *ce)
+{
+    php_h3_polygon *polygon = (php_h3_polygon *)ecalloc(1, sizeof(php_h3_polygon) + zend_object_properties_size(ce));
+
+    zend_object_std_init(&polygon->std, ce);
+    object_properties_init(&polygon->std, ce);
+    polygon->std.handlers = &php_h3_polygon_handlers;
+
+    return &polygon->std;
+}
+
+static void php_h3_polygon_free(zend_object *obj)
+{
+    php_h3_polygon *polygon = php_h3_polygon_from_obj(obj);
+
+    php_h3_geopolygon_free(&polygon->geopolygon);
+    free(polygon->bboxes);
+
+    zend_object_std_dtor(&polygon->std);
+}
+
+// A polygon argument given either as an array or as an H3Polygon, whose
+// parsed GeoPolygon is then used without copying.
+typedef struct _php_h3_polygon_input
+{
+    GeoPolygon *geopolygon;
+    GeoPolygon parsed;
+    zend_bool owned;
+} php_h3_polygon_input;
+
+static int php_h3_polygon_input_init(php_h3_polygon_input *in, zval *polygon_zval)
+{
+    in->owned = 0;
+
+    if (Z_TYPE_P(polygon_zval) == IS_OBJECT && Z_OBJCE_P(polygon_zval) == php_h3_polygon_ce)
+    {
+        in->geopolygon = &Z_H3_POLYGON_P(polygon_zval)->geopolygon;
+        return SUCCESS;
+    }
+
+    if (Z_TYPE_P(polygon_zval) != IS_ARRAY)
+    {
+        php_error_docref(NULL, E_WARNING, "Polygons must be given as an array or an H3Polygon");
+        return FAILURE;
+    }
+
+    if (php_h3_geopolygon_from_zval(polygon_zval, &in->parsed) == FAILURE)
+    {
+        return FAILURE;
+    }
+
+    in->geopolygon = &in->parsed;
+    in->owned = 1;
+
+    return SUCCESS;
+}
+
+static void php_h3_polygon_input_free(php_h3_polygon_input *in)
+{
+    if (in->owned)
+    {
+        php_h3_geopolygon_free(&in->parsed);
+    }
+    in->geopolygon = NULL;
+}
+/* }}} */
+
+/* {{{ polygon tiling
+ */
+// Tiles are clipped with this margin in radians so that a cell centered
+// exactly on a tile edge is still found; each cell is then kept only by the
+// tile owning its center
+#define PHP_H3_POLYFILL_TILE_OVERLAP 1e-9
+
+// Tiles narrower than this many radians are not split any further
+#define PHP_H3_POLYFILL_MIN_TILE 1e-6
+
+// A polygon prepared for filling tile by tile. Longitudes of polygons that
+// cross the antimeridian are shifted to [0, 2pi) while clipping so that the
+// bounding box is one continuous range, then east > west always holds.
+typedef struct _php_h3_polyfill_region
+{
+    const GeoPolygon *geopolygon;
+    int transmeridian;
+    php_h3_bbox bbox;
+} php_h3_polyfill_region;
+
+static void php_h3_polyfill_region_init(php_h3_polyfill_region *region, const GeoPolygon *geopolygon)
+{
+    region->geopolygon = geopolygon;
+    php_h3_bbox_from_geofence(&geopolygon->geofence, &region->bbox);
+    region->transmeridian = region->bbox.east < region->bbox.west;
+    if (region->transmeridian)
+    {
+        region->bbox.east += 2 * M_PI;
+    }
+}
+
+// Sutherland-Hodgman against one line of constant latitude (or longitude),
+// keeping the side at or above (or below) value. out must hold 2 * count
+// vertices. Returns the number of vertices written.
+static int php_h3_clip_loop(const GeoCoord *in, int count, int lon_axis, double value, int keep_greater, GeoCoord *out)
+{
+    int kept = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        const GeoCoord *a = &in[i];
+        const GeoCoord *b = &in[(i + 1) % count];
+        double a_value = lon_axis ? a->lon : a->lat;
+        double b_value = lon_axis ? b->lon : b->lat;
+        int a_in = keep_greater ? a_value >= value : a_value <= value;
+        int b_in = keep_greater ? b_value >= value : b_value <= value;
+
+        if (a_in)
+        {
+            out[kept++] = *a;
+        }
+        if (a_in != b_in)
+        {
+            double ratio = (value - a_value) / (b_value - a_value);
+
+            out[kept].lat = lon_axis ? a->lat + (b->lat - a->lat) * ratio : value;
+            out[kept].lon = lon_axis ? value : a->lon + (b->lon - a->lon) * ratio;
+            kept++;
+        }
+    }
+
+    return kept;
+}
+
+// Clips a loop to a rectangle given in region coordinates. Returns the number
+// of vertices left, owned by target, 0 when nothing with an area is left, or
+// -1 when memory ran out.
+static int php_h3_clip_geofence(const Geofence *source, const php_h3_bbox *rect, int transmeridian, Geofence *target)
+{
+    double values[4] = {rect->south, rect->north, rect->west, rect->east};
+    int count = source->numVerts;
+    GeoCoord *verts, *clipped = NULL;
+
+    target->numVerts = 0;
+    target->verts = NULL;
+
+    if (count < 3)
+    {
+        return 0;
+    }
+
+    verts = (GeoCoord *)malloc(count * sizeof(GeoCoord));
+    if (verts == NULL)
+    {
+        return -1;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        verts[i].lat = source->verts[i].lat;
+        verts[i].lon = PHP_H3_NORMALIZE_LON(source->verts[i].lon, transmeridian);
+    }
+
+    for (int pass = 0; pass < 4 && count >= 3; pass++)
+    {
+        GeoCoord *grown = (GeoCoord *)realloc(clipped, 2 * count * sizeof(GeoCoord));
+        GeoCoord *swap;
+
+        if (grown == NULL)
+        {
+            free(verts);
+            free(clipped);
+            return -1;
+        }
+
+        clipped = grown;
+        count = php_h3_clip_loop(verts, count, pass >= 2, values[pass], pass % 2 == 0, clipped);
+
+        swap = verts;
+        verts = clipped;
+        clipped = swap;
+    }
+    free(clipped);
+
+    if (count < 3)
+    {
+        free(verts);
+        return 0;
+    }
+
+    for (int i = 0; transmeridian && i < count; i++)
+    {
+        if (verts[i].lon > M_PI)
+        {
+            verts[i].lon -= 2 * M_PI;
+        }
+    }
+
+    target->numVerts = count;
+    target->verts = verts;
+
+    return count;
+}
+
+// Clips the polygon to a tile widened by the overlap. Returns 1 when
+// something is left, 0 when the tile is empty and -1 when memory ran out.
+// target must be released with php_h3_geopolygon_free when 1 is returned.
+static int php_h3_clip_geopolygon(const php_h3_polyfill_region *region, const php_h3_bbox *tile, GeoPolygon *target)
+{
+    const GeoPolygon *source = region->geopolygon;
+    php_h3_bbox rect = {
+        tile->north + PHP_H3_POLYFILL_TILE_OVERLAP,
+        tile->south - PHP_H3_POLYFILL_TILE_OVERLAP,
+        tile->east + PHP_H3_POLYFILL_TILE_OVERLAP,
+        tile->west - PHP_H3_POLYFILL_TILE_OVERLAP};
+    int verts;
+
+    target->numHoles = 0;
+    target->holes = NULL;
+
+    verts = php_h3_clip_geofence(&source->geofence, &rect, region->transmeridian, &target->geofence);
+    if (verts <= 0)
+    {
+        return verts < 0 ? -1 : 0;
+    }
+
+    if (source->numHoles > 0)
+    {
+        target->holes = (Geofence *)malloc(source->numHoles * sizeof(Geofence));
+        if (target->holes == NULL)
+        {
+            php_h3_geopolygon_free(target);
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < source->numHoles; i++)
+    {
+        verts = php_h3_clip_geofence(&source->holes[i], &rect, region->transmeridian, &target->holes[target->numHoles]);
+        if (verts < 0)
+        {
+            php_h3_geopolygon_free(target);
+            return -1;
+        }
+        if (verts > 0)
+        {
+            target->numHoles++;
+        }
+    }
+
+    return 1;
+}
+
+// Fills a clipped tile and keeps the cells whose center the tile owns: its
+// south and west edges are inclusive, its north and east edges only count
+// where they are also the edges of the region. Returns the number of cells
+// left in the malloc'd *cells, or -1 when memory ran out.
+static long php_h3_polyfill_tile(const php_h3_polyfill_region *region, const php_h3_bbox *tile, const GeoPolygon *clipped, int res, H3Index **cells)
+{
+    int estimate = maxPolyfillSize(clipped, res);
+    int north_edge = tile->north >= region->bbox.north;
+    int east_edge = tile->east >= region->bbox.east;
+    H3Index *out;
+    long kept = 0;
+
+    *cells = NULL;
+    if (estimate <= 0)
+    {
+        return 0;
+    }
+
+    out = (H3Index *)calloc(estimate, sizeof(H3Index));
+    if (out == NULL)
+    {
+        return -1;
+    }
+    polyfill(clipped, res, out);
+
+    for (int i = 0; i < estimate; i++)
+    {
+        GeoCoord center;
+        double lon;
+
+        if (out[i] == 0)
+        {
+            continue;
+        }
+
+        h3ToGeo(out[i], &center);
+        lon = PHP_H3_NORMALIZE_LON(center.lon, region->transmeridian);
+
+        if (center.lat < tile->south || (!north_edge && center.lat >= tile->north) || lon < tile->west || (!east_edge && lon >= tile->east))
+        {
+            continue;
+        }
+        out[kept++] = out[i];
+    }
+
+    *cells = out;
+
+    return kept;
+}
+/* }}} */
+
+/* {{{ parallel polyfill
+ */
+// Below this estimated size a serial polyfill is faster than starting threads
+#define PHP_H3_POLYFILL_PARALLEL_MIN_CELLS 16384
+
+// Tiles per thread, so that tiles crossing few cells do not leave threads idle
+#define PHP_H3_POLYFILL_TILES_PER_THREAD 4
+
+typedef struct _php_h3_polyfill_result
+{
+    H3Index *cells;
+    long count;
+} php_h3_polyfill_result;
+
+// The region's bounding box cut into rows x cols tiles of roughly square
+// ground size, since libh3 estimates the cells of a long thin box as if it
+// were a third as wide as it is long.
+typedef struct _php_h3_polyfill_grid
+{
+    const php_h3_polyfill_region *region;
+    int res;
+    size_t rows;
+    size_t cols;
+    php_h3_polyfill_result *results;
+} php_h3_polyfill_grid;
+
+static void php_h3_polyfill_grid_task(void *ctx, size_t index)
+{
+    php_h3_polyfill_grid *grid = (php_h3_polyfill_grid *)ctx;
+    const php_h3_bbox *bbox = &grid->region->bbox;
+    php_h3_polyfill_result *result = &grid->results[index];
+    size_t row = index / grid->cols, col = index % grid->cols;
+    double lat_step = (bbox->north - bbox->south) / grid->rows;
+    double lon_step = (bbox->east - bbox->west) / grid->cols;
+    php_h3_bbox tile;
+    GeoPolygon clipped;
+    int clip;
+
+    // a seam is computed from the same expression on both of its sides, so
+    // the tiles meeting there agree on it to the last bit
+    tile.south = bbox->south + lat_step * row;
+    tile.north = row + 1 == grid->rows ? bbox->north : bbox->south + lat_step * (row + 1);
+    tile.west = bbox->west + lon_step * col;
+    tile.east = col + 1 == grid->cols ? bbox->east : bbox->west + lon_step * (col + 1);
+
+    clip = php_h3_clip_geopolygon(grid->region, &tile, &clipped);
+    if (clip <= 0)
+    {
+        result->count = clip;
+        return;
+    }
+
+    result->count = php_h3_polyfill_tile(grid->region, &tile, &clipped, grid->res, &result->cells);
+    php_h3_geopolygon_free(&clipped);
+}
+
+// Fills the polygon tile by tile on the given number of threads. Returns a
+// malloc'd buffer of count unique cells, grouped by tile, or NULL when the
+// polygon has to be filled serially.
+static H3Index *php_h3_polyfill_parallel(const GeoPolygon *geopolygon, int res, zend_long threads, size_t *count)
+{
+    php_h3_polyfill_region region;
+    php_h3_polyfill_grid grid;
+    size_t tiles, total = 0;
+    H3Index *cells = NULL;
+    int failed = 0;
+    double aspect;
+
+    php_h3_polyfill_region_init(&region, geopolygon);
+    if (region.bbox.north <= region.bbox.south || region.bbox.east <= region.bbox.west)
+    {
+        return NULL;
+    }
+
+    if (threads > PHP_H3_MAX_THREADS)
+    {
+        threads = PHP_H3_MAX_THREADS;
+    }
+    tiles = (size_t)threads * PHP_H3_POLYFILL_TILES_PER_THREAD;
+
+    aspect = (region.bbox.east - region.bbox.west) * MAX(cos((region.bbox.north + region.bbox.south) / 2), 0.01) / (region.bbox.north - region.bbox.south);
+    grid.region = &region;
+    grid.res = res;
+    grid.rows = (size_t)MIN(MAX(round(sqrt(tiles / aspect)), 1), tiles);
+    grid.cols = (tiles + grid.rows - 1) / grid.rows;
+    grid.results = (php_h3_polyfill_result *)calloc(grid.rows * grid.cols, sizeof(php_h3_polyfill_result));
+
+    php_h3_parallel_for(grid.rows * grid.cols, threads, php_h3_polyfill_grid_task, &grid);
+
+    for (size_t i = 0; i < grid.rows * grid.cols; i++)
+    {
+        failed |= grid.results[i].count < 0;
+        total += grid.results[i].count > 0 ? grid.results[i].count : 0;
+    }
+
+    if (!failed)
+    {
+        cells = (H3Index *)malloc((total + 1) * sizeof(H3Index));
+    }
+
+    if (cells != NULL)
+    {
+        total = 0;
+        for (size_t i = 0; i < grid.rows * grid.cols; i++)
+        {
+            if (grid.results[i].count > 0)
+            {
+                memcpy(cells + total, grid.results[i].cells, grid.results[i].count * sizeof(H3Index));
+                total += grid.results[i].count;
+            }
+        }
+        *count = total;
+    }
+
+    for (size_t i = 0; i < grid.rows * grid.cols; i++)
+    {
+        free(grid.results[i].cells);
+    }
+    free(grid.results);
+
+    return cells;
+}
+/* }}} */
+
+/* {{{ H3PolyfillIterator storage
+ */
+// Default number of cells per chunk yielded by polyfillChunked()
+#define PHP_H3_POLYFILL_CHUNK_SIZE 65536
+
+// Tiles are split until their estimate is at most this many chunks, which
+// bounds the scratch buffer whatever the size of the polygon
+#define PHP_H3_POLYFILL_CHUNK_TILE_FACTOR 4
+
+// Fills a polygon lazily, one tile at a time, and hands the cells out in
+// chunks. Pending tiles are kept on a stack and split in two along their
+// longer side while libh3 estimates more cells than the scratch limit.
+typedef struct _php_h3_polyfill_iterator
+{
+    GeoPolygon parsed;
+    zval polygon;
+    php_h3_polyfill_region region;
+    int res;
+    zend_long chunk_size;
+    zend_long format;
+    size_t max_tile_cells;
+    php_h3_bbox *tiles;
+    size_t tile_count;
+    size_t tile_capacity;
+    H3Index *cells;
+    size_t cell_count;
+    size_t cell_pos;
+    zval current;
+    zend_long key;
+    zend_bool fresh;
+    zend_object std;
+} php_h3_polyfill_iterator;
+
+static zend_class_entry *php_h3_polyfill_iterator_ce;
+static zend_object_handlers php_h3_polyfill_iterator_handlers;
+
+static inline php_h3_polyfill_iterator *php_h3_polyfill_iterator_from_obj(zend_object *obj)
+{
+    return (php_h3_polyfill_iterator *)((char *)(obj)-XtOffsetOf(php_h3_polyfill_iterator, std));
+}
+
+#define Z_H3_POLYFILL_ITERATOR_P(zv) php_h3_polyfill_iterator_from_obj(Z_OBJ_P((zv)))
+
+static zend_object *php_h3_polyfill_iterator_create(zend_class_entry *ce)
+{
+    php_h3_polyfill_iterator *it = (php_h3_polyfill_iterator *)ecalloc(1, sizeof(php_h3_polyfill_iterator) + zend_object_properties_size(ce));
+
+    zend_object_std_init(&it->std, ce);
+    object_properties_init(&it->std, ce);
+    it->std.handlers = &php_h3_polyfill_iterator_handlers;
+    ZVAL_UNDEF(&it->polygon);
+    ZVAL_UNDEF(&it->current);
+
+    return &it->std;
+}
+
+static void php_h3_polyfill_iterator_free(zend_object *obj)
+{
+    php_h3_polyfill_iterator *it = php_h3_polyfill_iterator_from_obj(obj);
+
+    zval_ptr_dtor(&it->current);
+    zval_ptr_dtor(&it->polygon);
+    php_h3_geopolygon_free(&it->parsed);
+    free(it->cells);
+    if (it->tiles != NULL)
+    {
+        efree(it->tiles);
+    }
+
+    zend_object_std_dtor(&it->std);
+}
+
+static void php_h3_polyfill_iterator_push(php_h3_polyfill_iterator *it, const php_h3_bbox *tile)
+{
+    if (it->tile_count == it->tile_capacity)
+    {
+        it->tile_capacity = it->tile_capacity < 16 ? 16 : it->tile_capacity * 2;
+        it->tiles = (php_h3_bbox *)erealloc(it->tiles, it->tile_capacity * sizeof(php_h3_bbox));
+    }
+    it->tiles[it->tile_count++] = *tile;
+}
+
+// Fills pending tiles until one of them owns at least one cell. Returns
+// FAILURE once the polygon is exhausted.
+static int php_h3_polyfill_iterator_load(php_h3_polyfill_iterator *it)
+{
+    free(it->cells);
+    it->cells = NULL;
+    it->cell_count = 0;
+    it->cell_pos = 0;
+
+    while (it->tile_count > 0)
+    {
+        php_h3_bbox tile = it->tiles[--it->tile_count];
+        GeoPolygon clipped;
+        long count;
+        int clip = php_h3_clip_geopolygon(&it->region, &tile, &clipped);
+
+        if (clip == 0)
+        {
+            continue;
+        }
+        if (clip < 0)
+        {
+            php_error_docref(NULL, E_WARNING, "Out of memory while filling a polygon tile");
+            it->tile_count = 0;
+            return FAILURE;
+        }
+
+        double height = tile.north - tile.south;
+        double width = (tile.east - tile.west) * cos((tile.north + tile.south) / 2);
+
+        int estimate = maxPolyfillSize(&clipped, it->res);
+
+        if (estimate > 0 && (size_t)estimate > it->max_tile_cells && MAX(tile.north - tile.south, tile.east - tile.west) > PHP_H3_POLYFILL_MIN_TILE)
+        {
+            php_h3_bbox half = tile;
+
+            php_h3_geopolygon_free(&clipped);
+
+            // the southern or western half is pushed last so it is filled first
+            if (height >= width)
+            {
+                half.south = tile.south + (tile.north - tile.south) / 2;
+                tile.north = half.south;
+            }
+            else
+            {
+                half.west = tile.west + (tile.east - tile.west) / 2;
+                tile.east = half.west;
+            }
+            php_h3_polyfill_iterator_push(it, &half);
+            php_h3_polyfill_iterator_push(it, &tile);
+            continue;
+        }
+
+        count = php_h3_polyfill_tile(&it->region, &tile, &clipped, it->res, &it->cells);
+        php_h3_geopolygon_free(&clipped);
+
+        if (count < 0)
+        {
+            php_error_docref(NULL, E_WARNING, "Out of memory while filling a polygon tile");
+            it->tile_count = 0;
+            return FAILURE;
+        }
+        if (count > 0)
+        {
+            it->cell_count = (size_t)count;
+            return SUCCESS;
+        }
+
+        free(it->cells);
+        it->cells = NULL;
+    }
+
+    return FAILURE;
+}
+
+// Moves the next chunk into it->current, leaving it undefined at the end.
+static void php_h3_polyfill_iterator_fetch(php_h3_polyfill_iterator *it)
+{
+    php_h3_output out;
+    size_t count;
+
+    zval_ptr_dtor(&it->current);
+    ZVAL_UNDEF(&it->current);
+
+    if (it->cell_pos == it->cell_count && php_h3_polyfill_iterator_load(it) == FAILURE)
+    {
+        return;
+    }
+
+    count = MIN((size_t)it->chunk_size, it->cell_count - it->cell_pos);
+    H3Index *chunk = php_h3_output_init(&out, it->format, count);
+    memcpy(chunk, it->cells + it->cell_pos, count * sizeof(H3Index));
+    it->cell_pos += count;
+
+    php_h3_output_return(&out, count, &it->current);
+}
+
+static void php_h3_polyfill_iterator_rewind(php_h3_polyfill_iterator *it)
+{
+    free(it->cells);
+    it->cells = NULL;
+    it->cell_count = 0;
+    it->cell_pos = 0;
+    it->tile_count = 0;
+    it->key = 0;
+
+    if (it->region.geopolygon != NULL && it->region.bbox.north > it->region.bbox.south)
+    {
+        php_h3_polyfill_iterator_push(it, &it->region.bbox);
+    }
+
+    php_h3_polyfill_iterator_fetch(it);
+}
+/* }}} */
+
+/* {{{ polyfill result cache
+ */
+// Rough per-entry bookkeeping cost on top of the key and the cells
+#define PHP_H3_CACHE_ENTRY_OVERHEAD 64
+
+static size_t php_h3_polyfill_cache_entry_size(zend_string *key, zend_string *cells)
+{
+    return ZSTR_LEN(key) + ZSTR_LEN(cells) + PHP_H3_CACHE_ENTRY_OVERHEAD;
+}
+
+static void php_h3_cache_key_append_geofence(smart_str *key, const Geofence *geofence)
+{
+    smart_str_appendl(key, (const char *)&geofence->numVerts, sizeof(geofence->numVerts));
+    smart_str_appendl(key, (const char *)geofence->verts, geofence->numVerts * sizeof(GeoCoord));
+}
+
+// The key is the parsed vertices in radians plus the resolution; the cache
+// HashTable hashes it and compares it byte for byte on lookup.
+static zend_string *php_h3_polyfill_cache_key(const GeoPolygon *geopolygon, zend_long res)
+{
+    smart_str key = {0};
+
+    smart_str_appendl(&key, (const char *)&res, sizeof(res));
+    php_h3_cache_key_append_geofence(&key, &geopolygon->geofence);
+    smart_str_appendl(&key, (const char *)&geopolygon->numHoles, sizeof(geopolygon->numHoles));
+    for (int i = 0; i < geopolygon->numHoles; i++)
+    {
+        php_h3_cache_key_append_geofence(&key, &geopolygon->holes[i]);
+    }
+    smart_str_0(&key);
+
+    return key.s;
+}
+
+// Looks up a cached fill and marks it as most recently used.
+static zend_string *php_h3_polyfill_cache_find(zend_string *key)
+{
+    zval *cached = zend_hash_find(&H3_G(polyfill_cache), key);
+
+    if (cached == NULL)
+    {
+        H3_G(polyfill_cache_misses)++;
+        return NULL;
+    }
+
+    zend_string *cells = zend_string_copy(Z_STR_P(cached));
+    zval entry;
+
+    // re-insert so that eviction order follows the last use
+    zend_hash_del(&H3_G(polyfill_cache), key);
+    ZVAL_STR(&entry, cells);
+    zend_hash_add_new(&H3_G(polyfill_cache), key, &entry);
+    zend_string_addref(cells);
+
+    H3_G(polyfill_cache_hits)++;
+    return cells;
+}
+
+static void php_h3_polyfill_cache_store(zend_string *key, const H3Index *cells, size_t count)
+{
+    size_t limit = H3_G(polyfill_cache_size) > 0 ? (size_t)H3_G(polyfill_cache_size) : 0;
+    zend_string *stored = zend_string_init((const char *)cells, count * sizeof(H3Index), 0);
+    size_t size = php_h3_polyfill_cache_entry_size(key, stored);
+    zval entry;
+
+    if (size > limit)
+    {
+        zend_string_release(stored);
+        return;
+    }
+
+    // evict least recently used entries until the new one fits
+    while (H3_G(polyfill_cache_bytes) + size > limit && zend_hash_num_elements(&H3_G(polyfill_cache)) > 0)
+    {
+        zend_string *oldest_key = NULL;
+        zval *oldest;
+
+        ZEND_HASH_FOREACH_STR_KEY_VAL(&H3_G(polyfill_cache), oldest_key, oldest)
+        {
+            break;
+        }
+        ZEND_HASH_FOREACH_END();
+
+        H3_G(polyfill_cache_bytes) -= php_h3_polyfill_cache_entry_size(oldest_key, Z_STR_P(oldest));
+        zend_string_addref(oldest_key);
+        zend_hash_del(&H3_G(polyfill_cache), oldest_key);
+        zend_string_release(oldest_key);
+    }
+
+    ZVAL_STR(&entry, stored);
+    zend_hash_update(&H3_G(polyfill_cache), key, &entry);
+    H3_G(polyfill_cache_bytes) += size;
+}
+/* }}} */
+
+// The cells never include 0 entries or repeats, but their order is not part
+// of the contract: a serial fill keeps libh3's order, a threaded one groups
+// the cells by tile, and a cache hit returns whichever order was stored.
+PHP_FUNCTION(polyfill)
+{
+    zval *geopolygon_zval;
+    zend_long res, format = PHP_H3_FORMAT_ARRAY, threads = 0;
+    size_t polyfillsize;
+    php_h3_polygon_input polygon;
+    zend_string *cache_key = NULL;
+    php_h3_output out;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "zl|ll", &geopolygon_zval, &res, &format, &threads) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_polygon_input_init(&polygon, geopolygon_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    if (H3_G(polyfill_cache_size) > 0 || php_h3_shm_enabled())
+    {
+        zend_string *cached = NULL;
+
+        cache_key = php_h3_polyfill_cache_key(polygon.geopolygon, res);
+
+        if (H3_G(polyfill_cache_size) > 0)
+        {
+            cached = php_h3_polyfill_cache_find(cache_key);
+        }
+        if (cached == NULL)
+        {
+            cached = php_h3_shm_find(PHP_H3_SHM_KIND_POLYFILL, ZSTR_VAL(cache_key), ZSTR_LEN(cache_key));
+            if (cached != NULL && H3_G(polyfill_cache_size) > 0)
+            {
+                php_h3_polyfill_cache_store(cache_key, (const H3Index *)ZSTR_VAL(cached), ZSTR_LEN(cached) / sizeof(H3Index));
+            }
+        }
+
+        if (cached != NULL)
+        {
+            php_h3_polygon_input_free(&polygon);
+            zend_string_release(cache_key);
+            php_h3_return_cached(cached, format, return_value);
+            zend_string_release(cached);
+            return;
+        }
+    }
+
+    if (threads <= 0)
+    {
+        threads = H3_G(polyfill_threads);
+    }
+
+    int estimate = maxPolyfillSize(polygon.geopolygon, res);
+    polyfillsize = estimate > 0 ? (size_t)estimate : 0;
+    H3Index *polyfillOut;
+    H3Index *parallelOut = NULL;
+
+    if (threads > 1 && polyfillsize >= PHP_H3_POLYFILL_PARALLEL_MIN_CELLS)
+    {
+        parallelOut = php_h3_polyfill_parallel(polygon.geopolygon, res, threads, &polyfillsize);
+    }
+
+    if (parallelOut != NULL)
+    {
+        polyfillOut = php_h3_output_init(&out, format, polyfillsize);
+        memcpy(polyfillOut, parallelOut, polyfillsize * sizeof(H3Index));
+        free(parallelOut);
+    }
+    else
+    {
+        polyfillOut = php_h3_output_init(&out, format, polyfillsize);
+        polyfill(polygon.geopolygon, res, polyfillOut);
+        polyfillsize = php_h3_trim_indexes(polyfillOut, polyfillsize);
+    }
+
+    php_h3_polygon_input_free(&polygon);
+
+    if (cache_key != NULL)
+    {
+        if (H3_G(polyfill_cache_size) > 0)
+        {
+            php_h3_polyfill_cache_store(cache_key, polyfillOut, polyfillsize);
+        }
+        php_h3_shm_store(PHP_H3_SHM_KIND_POLYFILL, ZSTR_VAL(cache_key), ZSTR_LEN(cache_key), polyfillOut, polyfillsize);
+        zend_string_release(cache_key);
+    }
+
+    php_h3_output_return(&out, polyfillsize, return_value);
+}
+
+PHP_FUNCTION(polyfillChunked)
+{
+    zval *geopolygon_zval;
+    zend_long res, chunk_size = PHP_H3_POLYFILL_CHUNK_SIZE, format = PHP_H3_FORMAT_ARRAY;
+    php_h3_polyfill_iterator *it;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "zl|ll", &geopolygon_zval, &res, &chunk_size, &format) == FAILURE)
+    {
+        return;
+    }
+
+    if (chunk_size <= 0)
+    {
+        php_error_docref(NULL, E_WARNING, "Chunk size must be greater than 0");
+        RETURN_FALSE;
+    }
+
+    if (Z_TYPE_P(geopolygon_zval) != IS_ARRAY && !(Z_TYPE_P(geopolygon_zval) == IS_OBJECT && Z_OBJCE_P(geopolygon_zval) == php_h3_polygon_ce))
+    {
+        php_error_docref(NULL, E_WARNING, "Polygons must be given as an array or an H3Polygon");
+        RETURN_FALSE;
+    }
+
+    object_init_ex(return_value, php_h3_polyfill_iterator_ce);
+    it = Z_H3_POLYFILL_ITERATOR_P(return_value);
+
+    if (Z_TYPE_P(geopolygon_zval) == IS_OBJECT)
+    {
+        // the H3Polygon is kept alive for as long as its vertices are used
+        ZVAL_COPY(&it->polygon, geopolygon_zval);
+        php_h3_polyfill_region_init(&it->region, &Z_H3_POLYGON_P(geopolygon_zval)->geopolygon);
+    }
+    else
+    {
+        if (php_h3_geopolygon_from_zval(geopolygon_zval, &it->parsed) == FAILURE)
+        {
+            zval_ptr_dtor(return_value);
+            RETURN_FALSE;
+        }
+        php_h3_polyfill_region_init(&it->region, &it->parsed);
+    }
+
+    it->res = (int)res;
+    it->chunk_size = chunk_size;
+    it->format = format;
+    it->max_tile_cells = (size_t)MAX(chunk_size, 1024) * PHP_H3_POLYFILL_CHUNK_TILE_FACTOR;
+
+    php_h3_polyfill_iterator_rewind(it);
+    it->fresh = 1;
+}
+
+PHP_FUNCTION(maxPolyfillSize)
+{
+    zval *geopolygon_zval;
+    zend_long res;
+    int polyfillsize;
+    php_h3_polygon_input polygon;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "zl", &geopolygon_zval, &res) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_polygon_input_init(&polygon, geopolygon_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    polyfillsize = maxPolyfillSize(polygon.geopolygon, res);
+
+    php_h3_polygon_input_free(&polygon);
+
+    RETURN_LONG(polyfillsize);
+}
+
+/* {{{ GeoJSON and WKB writers
+ */
+// WKB geometry types
+#define PHP_H3_WKB_POLYGON 3
+#define PHP_H3_WKB_MULTIPOLYGON 6
+
+// Formats like json_encode() does, honouring serialize_precision.
+static void php_h3_json_append_double(smart_str *buf, double value)
+{
+    char num[64];
+
+    php_gcvt(value, (int)PG(serialize_precision), '.', 'e', num);
+    smart_str_appends(buf, num);
+}
+
+// Appends one [lon, lat] position in degrees.
+static void php_h3_json_append_position(smart_str *buf, const GeoCoord *coord)
+{
+    smart_str_appendc(buf, '[');
+    php_h3_json_append_double(buf, radsToDegs(coord->lon));
+    smart_str_appendc(buf, ',');
+    php_h3_json_append_double(buf, radsToDegs(coord->lat));
+    smart_str_appendc(buf, ']');
+}
+
+// Appends a linear ring, repeating the first vertex at the end as GeoJSON
+// requires; libh3 loops are open.
+static void php_h3_json_append_ring(smart_str *buf, const GeoCoord *verts, int count)
+{
+    smart_str_appendc(buf, '[');
+    for (int i = 0; i < count; i++)
+    {
+        php_h3_json_append_position(buf, &verts[i]);
+        smart_str_appendc(buf, ',');
+    }
+    php_h3_json_append_position(buf, &verts[0]);
+    smart_str_appendc(buf, ']');
+}
+
+static void php_h3_json_append_linked_ring(smart_str *buf, const LinkedGeoLoop *loop)
+{
+    smart_str_appendc(buf, '[');
+    for (const LinkedGeoCoord *coord = loop->first; coord != NULL; coord = coord->next)
+    {
+        php_h3_json_append_position(buf, &coord->vertex);
+        smart_str_appendc(buf, ',');
+    }
+    php_h3_json_append_position(buf, &loop->first->vertex);
+    smart_str_appendc(buf, ']');
+}
+
+// WKB is written little-endian (byte order flag 1) whatever the host is.
+static void php_h3_wkb_append_uint32(smart_str *buf, uint32_t value)
+{
+    char bytes[4];
+
+    for (int i = 0; i < 4; i++)
+    {
+        bytes[i] = (char)(value >> (8 * i));
+    }
+    smart_str_appendl(buf, bytes, 4);
+}
+
+static void php_h3_wkb_append_double(smart_str *buf, double value)
+{
+    char bytes[8];
+    uint64_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; i++)
+    {
+        bytes[i] = (char)(bits >> (8 * i));
+    }
+    smart_str_appendl(buf, bytes, 8);
+}
+
+static void php_h3_wkb_append_header(smart_str *buf, uint32_t type, uint32_t count)
+{
+    smart_str_appendc(buf, 1);
+    php_h3_wkb_append_uint32(buf, type);
+    php_h3_wkb_append_uint32(buf, count);
+}
+
+static void php_h3_wkb_append_point(smart_str *buf, const GeoCoord *coord)
+{
+    php_h3_wkb_append_double(buf, radsToDegs(coord->lon));
+    php_h3_wkb_append_double(buf, radsToDegs(coord->lat));
+}
+
+static void php_h3_wkb_append_ring(smart_str *buf, const GeoCoord *verts, int count)
+{
+    php_h3_wkb_append_uint32(buf, count + 1);
+    for (int i = 0; i < count; i++)
+    {
+        php_h3_wkb_append_point(buf, &verts[i]);
+    }
+    php_h3_wkb_append_point(buf, &verts[0]);
+}
+
+static void php_h3_wkb_append_linked_ring(smart_str *buf, const LinkedGeoLoop *loop)
+{
+    uint32_t count = 1;
+
+    for (const LinkedGeoCoord *coord = loop->first; coord != NULL; coord = coord->next)
+    {
+        count++;
+    }
+
+    php_h3_wkb_append_uint32(buf, count);
+    for (const LinkedGeoCoord *coord = loop->first; coord != NULL; coord = coord->next)
+    {
+        php_h3_wkb_append_point(buf, &coord->vertex);
+    }
+    php_h3_wkb_append_point(buf, &loop->first->vertex);
+}
+
+// Writes the outline of an index set as a GeoJSON MultiPolygon geometry or a
+// WKB MultiPolygon, walking libh3's linked polygons directly.
+static void php_h3_linked_geo_serialize(const LinkedGeoPolygon *polygon, int wkb, smart_str *buf)
+{
+    uint32_t polygons = 0;
+    const LinkedGeoPolygon *current;
+    int first_polygon = 1;
+
+    for (current = polygon; current != NULL; current = current->next)
+    {
+        polygons += current->first != NULL;
+    }
+
+    if (wkb)
+    {
+        php_h3_wkb_append_header(buf, PHP_H3_WKB_MULTIPOLYGON, polygons);
+    }
+    else
+    {
+        smart_str_appends(buf, "{\"type\":\"MultiPolygon\",\"coordinates\":[");
+    }
+
+    for (current = polygon; current != NULL; current = current->next)
+    {
+        const LinkedGeoLoop *loop;
+        uint32_t rings = 0;
+        int first_ring = 1;
+
+        if (current->first == NULL)
+        {
+            continue;
+        }
+
+        for (loop = current->first; loop != NULL; loop = loop->next)
+        {
+            rings += loop->first != NULL;
+        }
+
+        if (wkb)
+        {
+            php_h3_wkb_append_header(buf, PHP_H3_WKB_POLYGON, rings);
+        }
+        else
+        {
+            if (!first_polygon)
+            {
+                smart_str_appendc(buf, ',');
+            }
+            smart_str_appendc(buf, '[');
+            first_polygon = 0;
+        }
+
+        for (loop = current->first; loop != NULL; loop = loop->next)
+        {
+            if (loop->first == NULL)
+            {
+                continue;
+            }
+            if (wkb)
+            {
+                php_h3_wkb_append_linked_ring(buf, loop);
+                continue;
+            }
+            if (!first_ring)
+            {
+                smart_str_appendc(buf, ',');
+            }
+            php_h3_json_append_linked_ring(buf, loop);
+            first_ring = 0;
+        }
+
+        if (!wkb)
+        {
+            smart_str_appendc(buf, ']');
+        }
+    }
+
+    if (!wkb)
+    {
+        smart_str_appends(buf, "]}");
+    }
+}
+
+// Writes every cell boundary, either as a GeoJSON FeatureCollection with the
+// cell's hexadecimal index as feature id, or as a WKB MultiPolygon with one
+// polygon per cell in input order.
+static void php_h3_boundaries_serialize(const H3Index *indexes, int count, int wkb, smart_str *buf)
+{
+    if (wkb)
+    {
+        php_h3_wkb_append_header(buf, PHP_H3_WKB_MULTIPOLYGON, count);
+    }
+    else
+    {
+        smart_str_appends(buf, "{\"type\":\"FeatureCollection\",\"features\":[");
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        GeoBoundary boundary;
+
+        h3ToGeoBoundary(indexes[i], &boundary);
+
+        if (wkb)
+        {
+            php_h3_wkb_append_header(buf, PHP_H3_WKB_POLYGON, 1);
+            php_h3_wkb_append_ring(buf, boundary.verts, boundary.numVerts);
+            continue;
+        }
+
+        char id[17];
+        h3ToString(indexes[i], id, sizeof(id));
+
+        if (i > 0)
+        {
+            smart_str_appendc(buf, ',');
+        }
+        smart_str_appends(buf, "{\"type\":\"Feature\",\"id\":\"");
+        smart_str_appends(buf, id);
+        smart_str_appends(buf, "\",\"properties\":null,\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[");
+        php_h3_json_append_ring(buf, boundary.verts, boundary.numVerts);
+        smart_str_appends(buf, "]}}");
+    }
+
+    if (!wkb)
+    {
+        smart_str_appends(buf, "]}");
+    }
+}
+
+static void php_h3_set_serialize_impl(INTERNAL_FUNCTION_PARAMETERS, int boundaries, int wkb)
+{
+    zval *h3set_zval;
+    php_h3_input in;
+    smart_str buf = {0};
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "z", &h3set_zval) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_input_init(&in, h3set_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+    if (php_h3_input_check_int(&in) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    if (boundaries)
+    {
+        php_h3_boundaries_serialize(in.indexes, (int)in.length, wkb, &buf);
+    }
+    else
+    {
+        LinkedGeoPolygon polygon;
+
+        h3SetToLinkedGeo(in.indexes, (int)in.length, &polygon);
+        php_h3_linked_geo_serialize(&polygon, wkb, &buf);
+        destroyLinkedPolygon(&polygon);
+    }
+
+    php_h3_input_free(&in);
+
+    smart_str_0(&buf);
+    RETURN_STR(buf.s);
+}
+/* }}} */
+
+/* {{{ Mapbox Vector Tile encoder
+ */
+// Cells are clipped this many tile units outside the extent so that
+// renderers do not draw seams along tile edges
+#define PHP_H3_MVT_BUFFER 64
+
+// Scratch space for a clipped boundary: 10 vertices grow by at most one
+// vertex per edge and clipping pass
+#define PHP_H3_MVT_MAX_POINTS 256
+
+#define PHP_H3_MVT_MOVE_TO 1
+#define PHP_H3_MVT_LINE_TO 2
+#define PHP_H3_MVT_CLOSE_PATH 7
+#define PHP_H3_MVT_POLYGON 3
+
+#define PHP_H3_PBF_VARINT 0
+#define PHP_H3_PBF_FIXED64 1
+#define PHP_H3_PBF_BYTES 2
+
+static void php_h3_pbf_append_varint(smart_str *buf, uint64_t value)
+{
+    char bytes[10];
+    size_t len = 0;
+
+    while (value >= 0x80)
+    {
+        bytes[len++] = (char)((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    bytes[len++] = (char)value;
+
+    smart_str_appendl(buf, bytes, len);
+}
+
+static void php_h3_pbf_append_key(smart_str *buf, uint32_t field, int wire_type)
+{
+    php_h3_pbf_append_varint(buf, (field << 3) | wire_type);
+}
+
+static void php_h3_pbf_append_bytes(smart_str *buf, uint32_t field, const char *data, size_t len)
+{
+    php_h3_pbf_append_key(buf, field, PHP_H3_PBF_BYTES);
+    php_h3_pbf_append_varint(buf, len);
+    smart_str_appendl(buf, data, len);
+}
+
+// Appends a finished nested message and empties it for reuse.
+static void php_h3_pbf_append_message(smart_str *buf, uint32_t field, smart_str *message)
+{
+    if (message->s == NULL)
+    {
+        php_h3_pbf_append_bytes(buf, field, "", 0);
+        return;
+    }
+    php_h3_pbf_append_bytes(buf, field, ZSTR_VAL(message->s), ZSTR_LEN(message->s));
+    ZSTR_LEN(message->s) = 0;
+}
+
+static inline uint32_t php_h3_mvt_zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+// Sutherland-Hodgman on interleaved x/y tile coordinates against one edge.
+static int php_h3_mvt_clip_edge(const double *in, int count, int axis, double value, int keep_greater, double *out)
+{
+    int kept = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        const double *a = &in[i * 2];
+        const double *b = &in[((i + 1) % count) * 2];
+        int a_in = keep_greater ? a[axis] >= value : a[axis] <= value;
+        int b_in = keep_greater ? b[axis] >= value : b[axis] <= value;
+
+        if (a_in)
+        {
+            out[kept * 2] = a[0];
+            out[kept * 2 + 1] = a[1];
+            kept++;
+        }
+        if (a_in != b_in)
+        {
+            double ratio = (value - a[axis]) / (b[axis] - a[axis]);
+
+            out[kept * 2] = a[0] + (b[0] - a[0]) * ratio;
+            out[kept * 2 + 1] = a[1] + (b[1] - a[1]) * ratio;
+            out[kept * 2 + axis] = value;
+            kept++;
+        }
+    }
+
+    return kept;
+}
+
+// Reads a cell boundary as interleaved lon/lat degrees, unwrapping the
+// longitudes so that a cell crossing the antimeridian stays in one piece
+// reaching past +-180. Returns the number of vertices and sets wrap to the
+// shift (+-360, else 0) that brings the part past +-180 onto the map.
+static int php_h3_mvt_cell_boundary(H3Index cell, double *lonlat, double *wrap)
+{
+    double prev_lon = 0, min_lon = 180, max_lon = -180;
+    GeoBoundary boundary;
+
+    h3ToGeoBoundary(cell, &boundary);
+
+    for (int i = 0; i < boundary.numVerts; i++)
+    {
+        double lon = radsToDegs(boundary.verts[i].lon);
+
+        if (i > 0 && lon - prev_lon > 180)
+        {
+            lon -= 360;
+        }
+        else if (i > 0 && prev_lon - lon > 180)
+        {
+            lon += 360;
+        }
+        prev_lon = lon;
+        min_lon = MIN(min_lon, lon);
+        max_lon = MAX(max_lon, lon);
+
+        lonlat[i * 2] = lon;
+        lonlat[i * 2 + 1] = radsToDegs(boundary.verts[i].lat);
+    }
+
+    *wrap = min_lon < -180 ? 360 : (max_lon > 180 ? -360 : 0);
+
+    return boundary.numVerts;
+}
+
+// Projects a boundary from php_h3_mvt_cell_boundary(), moved by shift
+// degrees of longitude, to tile coordinates and clips it to the extent plus
+// the buffer. Returns the number of distinct integer points written to
+// points, exterior ring winding (positive surveyor's area), or 0 when
+// nothing with an area is left.
+static int php_h3_mvt_ring(const double *lonlat, int count, double shift, zend_long z, zend_long x, zend_long y, zend_long extent, int32_t *points)
+{
+    double scratch[2][PHP_H3_MVT_MAX_POINTS * 2];
+    double scale = (double)((int64_t)1 << z);
+    double low = -PHP_H3_MVT_BUFFER, high = (double)extent + PHP_H3_MVT_BUFFER;
+    double area = 0;
+    int kept = 0, current = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        double lon = lonlat[i * 2] + shift;
+        double lat = MAX(MIN(lonlat[i * 2 + 1], 85.0511287798066), -85.0511287798066) * PHP_H3_DEG_TO_RAD;
+
+        scratch[0][i * 2] = ((lon + 180.0) / 360.0 * scale - x) * extent;
+        scratch[0][i * 2 + 1] = ((1.0 - log(tan(lat) + 1.0 / cos(lat)) / M_PI) / 2.0 * scale - y) * extent;
+    }
+
+    for (int pass = 0; pass < 4 && count >= 3; pass++)
+    {
+        count = php_h3_mvt_clip_edge(scratch[current], count, pass / 2, pass % 2 == 0 ? low : high, pass % 2 == 0, scratch[1 - current]);
+        current = 1 - current;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int32_t px = (int32_t)lround(scratch[current][i * 2]);
+        int32_t py = (int32_t)lround(scratch[current][i * 2 + 1]);
+
+        if (kept > 0 && points[(kept - 1) * 2] == px && points[(kept - 1) * 2 + 1] == py)
+        {
+            continue;
+        }
+        points[kept * 2] = px;
+        points[kept * 2 + 1] = py;
+        kept++;
+    }
+    if (kept > 1 && points[0] == points[(kept - 1) * 2] && points[1] == points[(kept - 1) * 2 + 1])
+    {
+        kept--;
+    }
+    if (kept < 3)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < kept; i++)
+    {
+        int j = (i + 1) % kept;
+        area += (double)points[i * 2] * points[j * 2 + 1] - (double)points[j * 2] * points[i * 2 + 1];
+    }
+    if (area == 0)
+    {
+        return 0;
+    }
+    if (area < 0)
+    {
+        for (int i = 0, j = kept - 1; i < j; i++, j--)
+        {
+            int32_t tx = points[i * 2], ty = points[i * 2 + 1];
+            points[i * 2] = points[j * 2];
+            points[i * 2 + 1] = points[j * 2 + 1];
+            points[j * 2] = tx;
+            points[j * 2 + 1] = ty;
+        }
+    }
+
+    return kept;
+}
+
+// Encodes one ring as MoveTo, LineTo and ClosePath commands into a packed
+// uint32 field body. The cursor starts at the origin of every feature and
+// carries over from one ring to the next.
+static void php_h3_mvt_append_ring(smart_str *geometry, const int32_t *points, int count, int32_t *cursor)
+{
+    int32_t cx = cursor[0], cy = cursor[1];
+
+    php_h3_pbf_append_varint(geometry, PHP_H3_MVT_MOVE_TO | (1 << 3));
+    for (int i = 0; i < count; i++)
+    {
+        if (i == 1)
+        {
+            php_h3_pbf_append_varint(geometry, PHP_H3_MVT_LINE_TO | ((uint32_t)(count - 1) << 3));
+        }
+        php_h3_pbf_append_varint(geometry, php_h3_mvt_zigzag(points[i * 2] - cx));
+        php_h3_pbf_append_varint(geometry, php_h3_mvt_zigzag(points[i * 2 + 1] - cy));
+        cx = points[i * 2];
+        cy = points[i * 2 + 1];
+    }
+    php_h3_pbf_append_varint(geometry, PHP_H3_MVT_CLOSE_PATH | (1 << 3));
+
+    cursor[0] = cx;
+    cursor[1] = cy;
+}
+
+// Returns the index of an attribute value in the layer's values table,
+// adding it (as a Value message) the first time it is seen.
+static uint32_t php_h3_mvt_value_index(HashTable *seen, smart_str *layer, smart_str *scratch, zval *value_zval)
+{
+    char key[9];
+    zval *found, index_zval;
+
+    if (Z_TYPE_P(value_zval) == IS_DOUBLE)
+    {
+        double value = Z_DVAL_P(value_zval);
+        key[0] = 'd';
+        memcpy(key + 1, &value, 8);
+    }
+    else
+    {
+        zend_long value = zval_get_long(value_zval);
+        key[0] = 'l';
+        memcpy(key + 1, &value, 8);
+    }
+
+    if ((found = zend_hash_str_find(seen, key, sizeof(key))) != NULL)
+    {
+        return (uint32_t)Z_LVAL_P(found);
+    }
+
+    if (key[0] == 'd')
+    {
+        double value = Z_DVAL_P(value_zval);
+        uint64_t bits;
+        char bytes[8];
+
+        memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 8; i++)
+        {
+            bytes[i] = (char)(bits >> (8 * i));
+        }
+        php_h3_pbf_append_key(scratch, 3, PHP_H3_PBF_FIXED64);
+        smart_str_appendl(scratch, bytes, 8);
+    }
+    else
+    {
+        int64_t value = (int64_t)zval_get_long(value_zval);
+
+        php_h3_pbf_append_key(scratch, 6, PHP_H3_PBF_VARINT);
+        php_h3_pbf_append_varint(scratch, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+    }
+    php_h3_pbf_append_message(layer, 4, scratch);
+
+    ZVAL_LONG(&index_zval, zend_hash_num_elements(seen));
+    zend_hash_str_add(seen, key, sizeof(key), &index_zval);
+
+    return (uint32_t)Z_LVAL(index_zval);
+}
+/* }}} */
+
+PHP_FUNCTION(h3SetToLinkedGeo)
+{
+    zval *h3set_zval;
+    LinkedGeoPolygon polygon;
+    php_h3_input in;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "z", &h3set_zval) == FAILURE)
+    {
+        return;
+    }
+
+    if (php_h3_input_init(&in, h3set_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+    if (php_h3_input_check_int(&in) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    h3SetToLinkedGeo(in.indexes, (int)in.length, &polygon);
+
+    php_h3_input_free(&in);
+
+    LinkedGeoPolygon *polygonloop = &polygon;
+    array_init(return_value);
+
+    while (polygonloop != NULL)
+    {
+        zval geoloop_zval;
+        array_init(&geoloop_zval);
+
+        LinkedGeoLoop *geoloop = polygonloop->first;
+
+        while (geoloop != NULL)
+        {
+            zval geocoord_zval;
+            array_init(&geocoord_zval);
+
+            LinkedGeoCoord *coordloop = geoloop->first;
+
+            while (coordloop != NULL)
+            {
+                zval vertex_zval;
+                array_init(&vertex_zval);
+
+                double lat, lon;
+
+                lat = radsToDegs(coordloop->vertex.lat);
+                lon = radsToDegs(coordloop->vertex.lon);
+
+                add_assoc_double(&vertex_zval, "lat", lat);
+                add_assoc_double(&vertex_zval, "lon", lon);
+
+                add_next_index_zval(&geocoord_zval, &vertex_zval);
+
+                coordloop = coordloop->next;
+            }
+
+            add_next_index_zval(&geoloop_zval, &geocoord_zval);
+
+            geoloop = geoloop->next;
+        }
+
+        add_next_index_zval(return_value, &geoloop_zval);
+
+        polygonloop = polygonloop->next;
+    }
+
+    destroyLinkedPolygon(&polygon);
+}
+
+PHP_FUNCTION(h3SetToGeoJson)
+{
+    php_h3_set_serialize_impl(INTERNAL_FUNCTION_PARAM_PASSTHRU, 0, 0);
+}
+
+PHP_FUNCTION(h3SetToWkb)
+{
+    php_h3_set_serialize_impl(INTERNAL_FUNCTION_PARAM_PASSTHRU, 0, 1);
+}
+
+PHP_FUNCTION(h3ToGeoBoundaryGeoJson)
+{
+    php_h3_set_serialize_impl(INTERNAL_FUNCTION_PARAM_PASSTHRU, 1, 0);
+}
+
+PHP_FUNCTION(h3ToGeoBoundaryWkb)
+{
+    php_h3_set_serialize_impl(INTERNAL_FUNCTION_PARAM_PASSTHRU, 1, 1);
+}
+
+// Encodes the cells as polygon features of one Mapbox Vector Tile layer.
+// attributes maps attribute names to lists of numbers aligned with the
+// cells; null or missing entries leave the attribute out for that cell.
+PHP_FUNCTION(h3ToMvt)
+{
+    zval *h3set_zval, *attributes_zval = NULL, *values_zval;
+    zend_long z, x, y, extent = 4096;
+    char *layer_name = "h3";
+    size_t layer_name_len = 2;
+    php_h3_input in;
+    smart_str tile = {0}, layer = {0}, features = {0}, values = {0}, feature = {0}, tags = {0}, geometry = {0}, scratch = {0};
+    // room for a cell and its copy on the other side of the antimeridian
+    int32_t points[2 * PHP_H3_MVT_MAX_POINTS * 2];
+    double lonlat[PHP_H3_MVT_MAX_POINTS * 2];
+    HashTable seen;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "zlll|a!sl", &h3set_zval, &z, &x, &y, &attributes_zval, &layer_name, &layer_name_len, &extent) == FAILURE)
+    {
+        return;
+    }
+
+    if (z < 0 || z > 30 || x < 0 || y < 0 || x >= ((zend_long)1 << z) || y >= ((zend_long)1 << z))
+    {
+        php_error_docref(NULL, E_WARNING, "Invalid tile coordinates");
+        RETURN_FALSE;
+    }
+
+    if (extent <= 0 || extent > 0x40000)
+    {
+        php_error_docref(NULL, E_WARNING, "Extent must be between 1 and 262144");
+        RETURN_FALSE;
+    }
+
+    if (php_h3_input_init(&in, h3set_zval) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    zend_hash_init(&seen, 16, NULL, NULL, 0);
+
+    for (size_t i = 0; i < in.length; i++)
+    {
+        double wrap;
+        int vertices = php_h3_mvt_cell_boundary(in.indexes[i], lonlat, &wrap);
+        int count = php_h3_mvt_ring(lonlat, vertices, 0, z, x, y, extent, points);
+        // a cell crossing the antimeridian is drawn on both sides of the map
+        int wrapped = wrap != 0 ? php_h3_mvt_ring(lonlat, vertices, wrap, z, x, y, extent, points + count * 2) : 0;
+        int32_t cursor[2] = {0, 0};
+
+        if (count + wrapped == 0)
+        {
+            continue;
+        }
+
+        php_h3_pbf_append_key(&feature, 1, PHP_H3_PBF_VARINT);
+        php_h3_pbf_append_varint(&feature, in.indexes[i]);
+
+        if (attributes_zval != NULL)
+        {
+            uint32_t key_index = 0;
+
+            ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(attributes_zval), values_zval)
+            {
+                zval *value_zval;
+
+                ZVAL_DEREF(values_zval);
+                if (Z_TYPE_P(values_zval) == IS_ARRAY && (value_zval = zend_hash_index_find(Z_ARRVAL_P(values_zval), i)) != NULL)
+                {
+                    ZVAL_DEREF(value_zval);
+                    if (Z_TYPE_P(value_zval) != IS_NULL)
+                    {
+                        php_h3_pbf_append_varint(&tags, key_index);
+                        php_h3_pbf_append_varint(&tags, php_h3_mvt_value_index(&seen, &values, &scratch, value_zval));
+                    }
+                }
+                key_index++;
+            }
+            ZEND_HASH_FOREACH_END();
+
+            if (tags.s != NULL && ZSTR_LEN(tags.s) > 0)
+            {
+                php_h3_pbf_append_message(&feature, 2, &tags);
+            }
+        }
+
+        php_h3_pbf_append_key(&feature, 3, PHP_H3_PBF_VARINT);
+        php_h3_pbf_append_varint(&feature, PHP_H3_MVT_POLYGON);
+
+        if (count > 0)
+        {
+            php_h3_mvt_append_ring(&geometry, points, count, cursor);
+        }
+        if (wrapped > 0)
+        {
+            php_h3_mvt_append_ring(&geometry, points + count * 2, wrapped, cursor);
+        }
+        php_h3_pbf_append_message(&feature, 4, &geometry);
+
+        php_h3_pbf_append_message(&features, 2, &feature);
+    }
+
+    php_h3_input_free(&in);
+
+    php_h3_pbf_append_bytes(&layer, 1, layer_name, layer_name_len);
+    if (features.s != NULL)
+    {
+        smart_str_appendl(&layer, ZSTR_VAL(features.s), ZSTR_LEN(features.s));
+    }
+    if (attributes_zval != NULL)
+    {
+        zend_string *name;
+        zend_ulong num_name;
+
+        ZEND_HASH_FOREACH_KEY(Z_ARRVAL_P(attributes_zval), num_name, name)
+        {
+            if (name != NULL)
+            {
+                php_h3_pbf_append_bytes(&layer, 3, ZSTR_VAL(name), ZSTR_LEN(name));
+            }
+            else
+            {
+                char num[32];
+                int len = snprintf(num, sizeof(num), ZEND_ULONG_FMT, num_name);
+                php_h3_pbf_append_bytes(&layer, 3, num, len);
+            }
+        }
+        ZEND_HASH_FOREACH_END();
+    }
+    if (values.s != NULL)
+    {
+        smart_str_appendl(&layer, ZSTR_VAL(values.s), ZSTR_LEN(values.s));
+    }
+    php_h3_pbf_append_key(&layer, 5, PHP_H3_PBF_VARINT);
+    php_h3_pbf_append_varint(&layer, extent);
+    php_h3_pbf_append_key(&layer, 15, PHP_H3_PBF_VARINT);
+    php_h3_pbf_append_varint(&layer, 2);
+
+    php_h3_pbf_append_message(&tile, 3, &layer);
+
+    zend_hash_destroy(&seen);
+    smart_str_free(&layer);
+    smart_str_free(&features);
+    smart_str_free(&values);
+    smart_str_free(&feature);
+    smart_str_free(&tags);
+    smart_str_free(&geometry);
+    smart_str_free(&scratch);
+
+    smart_str_0(&tile);
+    RETURN_STR(tile.s);
+}
+
+PHP_FUNCTION(degsToRads)
+{
+    double lat_lon;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "d", &lat_lon) == FAILURE)
+    {
+        return;
+    }
+
+    double radians_lat_lon = degsToRads(lat_lon);
+
+    RETURN_DOUBLE(radians_lat_lon);
+}
+
+PHP_FUNCTION(radsToDegs)
+{
+    double lat_lon;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "d", &lat_lon) == FAILURE)
+    {
+        return;
+    }
+
+    double degrees_lat_lon = radsToDegs(lat_lon);
+
+    RETURN_DOUBLE(degrees_lat_lon);
+}
+
+PHP_FUNCTION(hexAreaKm2)
+{
+    zend_long res;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &res) == FAILURE)
+    {
+        return;
+    }
+
+    double kilometers2 = hexAreaKm2(res);
+
+    RETURN_DOUBLE(kilometers2);
+}
+
+PHP_FUNCTION(hexAreaM2)
+{
+    zend_long res;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &res) == FAILURE)
+    {
+        return;
+    }
+
+    double meters2 = hexAreaM2(res);
+
+    RETURN_DOUBLE(meters2);
+}
+
+PHP_FUNCTION(cellAreaKm2)
+{
+    zend_long h;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &h) == FAILURE)
+    {
+        return;
+    }
+
+    double kilometers2 = cellAreaKm2(h);
+
+    RETURN_DOUBLE(kilometers2);
+}
+
+PHP_FUNCTION(cellAreaM2)
+{
+    zend_long h;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &h) == FAILURE)
+    {
+        return;
+    }
+
+    double meters2 = cellAreaM2(h);
+
+    RETURN_DOUBLE(meters2);
+}
+
+PHP_FUNCTION(cellAreaRads2)
+{
+    zend_long h;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &h) == FAILURE)
+    {
+        return;
+    }
+
+    double rads2 = cellAreaRads2(h);
+
+    RETURN_DOUBLE(rads2);
+}
+
+PHP_FUNCTION(edgeLengthKm)
+{
+    zend_long res;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &res) == FAILURE)
+    {
+        return;
+    }
+
+    double kilometers = edgeLengthKm(res);
+
+    RETURN_DOUBLE(kilometers);
+}
+
+PHP_FUNCTION(edgeLengthM)
+{
+    zend_long res;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &res) == FAILURE)
+    {
+        return;
+    }
+
+    double meters = edgeLengthM(res);
+
+    RETURN_DOUBLE(meters);
+}
+
+PHP_FUNCTION(exactEdgeLengthKm)
+{
+    zend_long edge;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    {
+        return;
+    }
+
+    double kilometers = exactEdgeLengthKm(edge);
+
+    RETURN_DOUBLE(kilometers);
+}
+
+PHP_FUNCTION(exactEdgeLengthM)
+{
+    zend_long edge;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    {
+        return;
+    }
+
+    double meters = exactEdgeLengthM(edge);
+
+    RETURN_DOUBLE(meters);
+}
+
+PHP_FUNCTION(exactEdgeLengthRads)
+{
+    zend_long edge;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    {
+        return;
+    }
+
+    double rads = exactEdgeLengthM(edge);
+
+    RETURN_DOUBLE(rads);
+}
+
+PHP_FUNCTION(numHexagons)
+{
+    zend_long res;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &res) == FAILURE)
+    {
+        return;
+    }
+
+    zend_long number_of_indexes = numHexagons(res);
+
+    RETURN_LONG(number_of_indexes);
+}
+
+PHP_FUNCTION(getRes0Indexes)
+{
+    zend_long format = PHP_H3_FORMAT_ARRAY;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "|l", &format) == FAILURE)
+    {
+        return;
+    }
+
+#if PHP_VERSION_ID >= 70300
+    php_h3_table_return(php_h3_res0_cells, PHP_H3_RES0_COUNT, php_h3_res0_packed, php_h3_res0_array, format, return_value);
+#else
+    php_h3_table_return(php_h3_res0_cells, PHP_H3_RES0_COUNT, php_h3_res0_packed, NULL, format, return_value);
+#endif
+}
+
+PHP_FUNCTION(res0IndexCount)
+{
+    RETURN_LONG(PHP_H3_RES0_COUNT);
+}
+
+PHP_FUNCTION(getPentagonIndexes)
+{
+    zend_long res, format = PHP_H3_FORMAT_ARRAY;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l|l", &res, &format) == FAILURE)
+    {
+        return;
+    }
+
+    if (res < 0 || res > MAX_H3_RES)
+    {
+        php_error_docref(NULL, E_WARNING, "Resolution must be between 0 and 15");
+        RETURN_FALSE;
+    }
+
+#if PHP_VERSION_ID >= 70300
+    php_h3_table_return(php_h3_pentagons[res], PHP_H3_PENTAGON_COUNT, php_h3_pentagons_packed[res], php_h3_pentagons_array[res], format, return_value);
+#else
+    php_h3_table_return(php_h3_pentagons[res], PHP_H3_PENTAGON_COUNT, php_h3_pentagons_packed[res], NULL, format, return_value);
+#endif
+}
+
+PHP_FUNCTION(pentagonIndexCount)
+{
+    RETURN_LONG(PHP_H3_PENTAGON_COUNT);
+}
+
+PHP_FUNCTION(pointDistKm)
+{
+    zval *a_zval, *b_zval;
+    GeoCoord a, b;
+    double kilometers;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "aa", &a_zval, &b_zval) == FAILURE)
+    {
+        return;
+    }
+
+    a.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(a_zval), "lat", 3)));
+    a.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(a_zval), "lon", 3)));
+    b.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(b_zval), "lat", 3)));
+    b.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(b_zval), "lon", 3)));
+
+    kilometers = pointDistKm(&a, &b);
+
+    RETURN_DOUBLE(kilometers);
+}
+
+PHP_FUNCTION(pointDistM)
 {
-    zend_long k;
-    zend_long size;
+    zval *a_zval, *b_zval;
+    GeoCoord a, b;
+    double meters;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &k) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "aa", &a_zval, &b_zval) == FAILURE)
     {
         return;
     }
 
-    size = maxKringSize(k);
+    a.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(a_zval), "lat", 3)));
+    a.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(a_zval), "lon", 3)));
+    b.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(b_zval), "lat", 3)));
+    b.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(b_zval), "lon", 3)));
 
-    RETURN_LONG(size);
+    meters = pointDistM(&a, &b);
+
+    RETURN_DOUBLE(meters);
 }
 
-PHP_FUNCTION(kRingDistances)
+PHP_FUNCTION(pointDistRads)
 {
-    zend_long indexed, k;
+    zval *a_zval, *b_zval;
+    GeoCoord a, b;
+    double rads;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &k) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "aa", &a_zval, &b_zval) == FAILURE)
     {
         return;
     }
 
-    int arr_count = maxKringSize(k);
+    a.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(a_zval), "lat", 3)));
+    a.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(a_zval), "lon", 3)));
+    b.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(b_zval), "lat", 3)));
+    b.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(b_zval), "lon", 3)));
 
-    H3Index *outs = (H3Index *)calloc(arr_count, sizeof(H3Index));
-    int *distances = (int *)calloc(arr_count, sizeof(int));
-    kRingDistances(indexed, k, outs, distances);
+    rads = pointDistRads(&a, &b);
 
-    zval out_zvals, distance_zvals;
-    array_init(&out_zvals);
-    array_init(&distance_zvals);
+    RETURN_DOUBLE(rads);
+}
 
-    for (int i = 0; i < arr_count; i++)
+// Returns the counters of every function called since startup or the last
+// h3_stats_reset(), in this process or thread.
+PHP_FUNCTION(h3_stats)
+{
+    if (zend_parse_parameters_none() == FAILURE)
     {
-        add_index_long(&out_zvals, i, outs[i]);
-        add_index_long(&distance_zvals, i, distances[i]);
+        return;
     }
 
     array_init(return_value);
-    add_index_zval(return_value, 0, &out_zvals);
-    add_index_zval(return_value, 1, &distance_zvals);
 
-    free(outs);
-    free(distances);
+    for (size_t i = 0; i < php_h3_stats_count; i++)
+    {
+        php_h3_stats_entry *entry = &H3_G(stats)[i];
+        zval entry_zval;
+
+        if (entry->calls == 0)
+        {
+            continue;
+        }
+
+        array_init_size(&entry_zval, 4);
+        add_assoc_long(&entry_zval, "calls", (zend_long)entry->calls);
+        add_assoc_long(&entry_zval, "time_ns", (zend_long)entry->ns);
+        add_assoc_long(&entry_zval, "cells", (zend_long)entry->cells);
+        add_assoc_long(&entry_zval, "bytes", (zend_long)entry->bytes);
+        zend_hash_update(Z_ARRVAL_P(return_value), php_h3_stats_names[i], &entry_zval);
+    }
 }
 
-PHP_FUNCTION(hexRange)
+PHP_FUNCTION(h3_stats_reset)
 {
-    zend_long indexed, k;
-
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &k) == FAILURE)
+    if (zend_parse_parameters_none() == FAILURE)
     {
         return;
     }
 
-    int arr_count = maxKringSize(k);
+    memset(H3_G(stats), 0, sizeof(H3_G(stats)));
+}
 
-    H3Index *outs = (H3Index *)calloc(arr_count, sizeof(H3Index));
-    if (hexRange(indexed, k, outs) != 0)
+// Returns the scratch arena size, the bytes in use, the most ever in use and
+// how many buffers did not fit and were malloc()ed instead.
+PHP_FUNCTION(h3_arena_stats)
+{
+    if (zend_parse_parameters_none() == FAILURE)
     {
-        RETURN_FALSE;
+        return;
     }
 
-    array_init(return_value);
+    array_init_size(return_value, 4);
+    add_assoc_long(return_value, "size", H3_G(arena_size));
+    add_assoc_long(return_value, "used", (zend_long)H3_G(arena_used));
+    add_assoc_long(return_value, "high_water", (zend_long)H3_G(arena_high_water));
+    add_assoc_long(return_value, "fallbacks", H3_G(arena_fallbacks));
+}
 
-    for (int i = 0; i < arr_count; i++)
-    {
-        add_index_long(return_value, i, outs[i]);
-    }
+/* {{{ H3IndexSet class
+ */
+static int php_h3_index_set_offset(php_h3_index_set *set, zval *offset_zval, zend_long *offset)
+{
+    *offset = zval_get_long(offset_zval);
 
-    free(outs);
+    return *offset >= 0 && (size_t)*offset < set->count ? SUCCESS : FAILURE;
 }
 
-PHP_FUNCTION(hexRangeDistances)
+PHP_METHOD(H3IndexSet, __construct)
 {
-    zend_long indexed, k;
+    zval *indexes_zval = NULL;
+    php_h3_input in;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &k) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "|z", &indexes_zval) == FAILURE)
     {
         return;
     }
 
-    int arr_count = maxKringSize(k);
-
-    H3Index *outs = (H3Index *)calloc(arr_count, sizeof(H3Index));
-    int *distances = (int *)calloc(arr_count, sizeof(int));
-    if (hexRangeDistances(indexed, k, outs, distances) != 0)
+    if (indexes_zval == NULL || Z_TYPE_P(indexes_zval) == IS_NULL)
     {
-        RETURN_FALSE;
+        return;
     }
 
-    zval out_zvals, distance_zvals;
-    array_init(&out_zvals);
-    array_init(&distance_zvals);
-
-    for (int i = 0; i < arr_count; i++)
+    if (php_h3_input_init(&in, indexes_zval) == FAILURE)
     {
-        add_index_long(&out_zvals, i, outs[i]);
-        add_index_long(&distance_zvals, i, distances[i]);
+        zend_throw_exception(zend_ce_exception, "H3IndexSet expects an array, a packed string or an H3IndexSet", 0);
+        return;
     }
 
-    array_init(return_value);
-    add_index_zval(return_value, 0, &out_zvals);
-    add_index_zval(return_value, 1, &distance_zvals);
+    php_h3_index_set_append(Z_H3_INDEX_SET_P(getThis()), in.indexes, in.length);
 
-    free(outs);
-    free(distances);
+    php_h3_input_free(&in);
 }
 
-PHP_FUNCTION(hexRanges)
+PHP_METHOD(H3IndexSet, count)
 {
-    zend_long k;
-    zval *h3Set_zval;
-
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "al", &h3Set_zval, &k) == FAILURE)
+    if (zend_parse_parameters_none() == FAILURE)
     {
         return;
     }
 
-    int length = zend_hash_num_elements(Z_ARRVAL_P(h3Set_zval));
-    H3Index *indexed = (H3Index *)calloc(length, sizeof(H3Index));
-
-    zval *h3Indexed_zval;
-    zend_ulong i;
+    RETURN_LONG(Z_H3_INDEX_SET_P(getThis())->count);
+}
 
-    ZEND_HASH_FOREACH_NUM_KEY_VAL(Z_ARRVAL_P(h3Set_zval), i, h3Indexed_zval)
+PHP_METHOD(H3IndexSet, getIterator)
+{
+    if (zend_parse_parameters_none() == FAILURE)
     {
-        indexed[i] = Z_LVAL_P(h3Indexed_zval);
+        return;
     }
-    ZEND_HASH_FOREACH_END();
 
-    int arr_count = maxKringSize(k) * length;
-
-    H3Index *outs = (H3Index *)calloc(arr_count, sizeof(H3Index));
-    if (hexRanges(indexed, length, k, outs) != 0)
-    {
-        RETURN_FALSE;
-    }
+#if PHP_VERSION_ID >= 80000
+    zend_create_internal_iterator_zval(return_value, getThis());
+#else
+    // foreach uses the native iterator, so the set itself is the Traversable
+    ZVAL_COPY(return_value, getThis());
+#endif
+}
 
-    array_init(return_value);
+PHP_METHOD(H3IndexSet, offsetExists)
+{
+    zval *offset_zval;
+    zend_long offset;
 
-    for (int i = 0; i < arr_count; i++)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "z", &offset_zval) == FAILURE)
     {
-        add_index_long(return_value, i, outs[i]);
+        return;
     }
 
-    free(indexed);
-    free(outs);
+    RETURN_BOOL(php_h3_index_set_offset(Z_H3_INDEX_SET_P(getThis()), offset_zval, &offset) == SUCCESS);
 }
 
-PHP_FUNCTION(hexRing)
+PHP_METHOD(H3IndexSet, offsetGet)
 {
-    zend_long indexed, k;
+    zval *offset_zval;
+    zend_long offset;
+    php_h3_index_set *set = Z_H3_INDEX_SET_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &k) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "z", &offset_zval) == FAILURE)
     {
         return;
     }
 
-    int arr_count = 6 * k;
-
-    H3Index *outs = (H3Index *)calloc(arr_count, sizeof(H3Index));
-    if (hexRing(indexed, k, outs) != 0)
-    {
-        RETURN_FALSE;
-    }
-
-    array_init(return_value);
-
-    for (int i = 0; i < arr_count; i++)
+    if (php_h3_index_set_offset(set, offset_zval, &offset) == FAILURE)
     {
-        add_index_long(return_value, i, outs[i]);
+        zend_throw_exception(zend_ce_exception, "Index invalid or out of range", 0);
+        return;
     }
 
-    free(outs);
+    RETURN_LONG(set->indexes[offset]);
 }
 
-PHP_FUNCTION(h3Line)
+PHP_METHOD(H3IndexSet, offsetSet)
 {
-    zend_long start, end;
-    int size;
+    zval *offset_zval, *value_zval;
+    zend_long offset;
+    php_h3_index_set *set = Z_H3_INDEX_SET_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &start, &end) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "zz", &offset_zval, &value_zval) == FAILURE)
     {
         return;
     }
 
-    size = h3LineSize(start, end);
-
-    H3Index *outs = (H3Index *)calloc(size, sizeof(H3Index));
+    H3Index value = zval_get_long(value_zval);
 
-    if (h3Line(start, end, outs) != 0)
+    // $set[] = $index and writes just past the end append
+    if (Z_TYPE_P(offset_zval) == IS_NULL || zval_get_long(offset_zval) == (zend_long)set->count)
     {
-        RETURN_FALSE;
+        php_h3_index_set_append(set, &value, 1);
+        return;
     }
 
-    array_init(return_value);
-
-    for (int i = 0; i < size; i++)
+    if (php_h3_index_set_offset(set, offset_zval, &offset) == FAILURE)
     {
-        add_index_long(return_value, i, outs[i]);
+        zend_throw_exception(zend_ce_exception, "Index invalid or out of range", 0);
+        return;
     }
 
-    free(outs);
+    set->indexes[offset] = value;
 }
 
-PHP_FUNCTION(h3LineSize)
+PHP_METHOD(H3IndexSet, offsetUnset)
 {
-    zend_long start, end;
-    int size;
+    zval *offset_zval;
+    zend_long offset;
+    php_h3_index_set *set = Z_H3_INDEX_SET_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &start, &end) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "z", &offset_zval) == FAILURE)
     {
         return;
     }
 
-    size = h3LineSize(start, end);
-
-    if (size < 0)
-    {
-        RETURN_FALSE;
-    }
-    else
+    if (php_h3_index_set_offset(set, offset_zval, &offset) == FAILURE)
     {
-        RETURN_LONG(size);
+        return;
     }
+
+    memmove(set->indexes + offset, set->indexes + offset + 1, (set->count - offset - 1) * sizeof(H3Index));
+    set->count--;
 }
 
-PHP_FUNCTION(h3Distance)
+PHP_METHOD(H3IndexSet, toArray)
 {
-    zend_long origin, h3;
-    int distance;
+    php_h3_index_set *set = Z_H3_INDEX_SET_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &origin, &h3) == FAILURE)
+    if (zend_parse_parameters_none() == FAILURE)
     {
         return;
     }
 
-    distance = h3Distance(origin, h3);
-
-    RETURN_LONG(distance);
+    php_h3_array_from_indexes(return_value, set->indexes, set->count);
 }
 
-//This function is experimental, and its output is not guaranteed to be compatible across different versions of H3.
-PHP_FUNCTION(experimentalH3ToLocalIj)
+PHP_METHOD(H3IndexSet, toPacked)
 {
-    zend_long origin, h3;
-    CoordIJ ij;
+    php_h3_index_set *set = Z_H3_INDEX_SET_P(getThis());
+    php_h3_output out;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &origin, &h3) == FAILURE)
+    if (zend_parse_parameters_none() == FAILURE)
     {
         return;
     }
 
-    if (experimentalH3ToLocalIj(origin, h3, &ij) != 0)
-    {
-        RETURN_FALSE;
-    }
-    else
-    {
-        array_init(return_value);
-        add_assoc_long(return_value, "i", ij.i);
-        add_assoc_long(return_value, "j", ij.j);
-    }
+    H3Index *outs = php_h3_output_init(&out, PHP_H3_FORMAT_PACKED, set->count);
+    memcpy(outs, set->indexes, set->count * sizeof(H3Index));
+
+    php_h3_output_return(&out, set->count, return_value);
 }
 
-//This function is experimental, and its output is not guaranteed to be compatible across different versions of H3.
-PHP_FUNCTION(experimentalLocalIjToH3)
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3indexset_construct, 0, 0, 0)
+    ZEND_ARG_INFO(0, indexes)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3indexset_void, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3indexset_offset, 0, 0, 1)
+    ZEND_ARG_INFO(0, offset)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3indexset_offset_set, 0, 0, 2)
+    ZEND_ARG_INFO(0, offset)
+    ZEND_ARG_INFO(0, value)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry php_h3_index_set_methods[] = {
+    PHP_ME(H3IndexSet, __construct, arginfo_h3indexset_construct, ZEND_ACC_PUBLIC)
+    PHP_ME(H3IndexSet, count, arginfo_h3indexset_void, ZEND_ACC_PUBLIC)
+    PHP_ME(H3IndexSet, getIterator, arginfo_h3indexset_void, ZEND_ACC_PUBLIC)
+    PHP_ME(H3IndexSet, offsetExists, arginfo_h3indexset_offset, ZEND_ACC_PUBLIC)
+    PHP_ME(H3IndexSet, offsetGet, arginfo_h3indexset_offset, ZEND_ACC_PUBLIC)
+    PHP_ME(H3IndexSet, offsetSet, arginfo_h3indexset_offset_set, ZEND_ACC_PUBLIC)
+    PHP_ME(H3IndexSet, offsetUnset, arginfo_h3indexset_offset, ZEND_ACC_PUBLIC)
+    PHP_ME(H3IndexSet, toArray, arginfo_h3indexset_void, ZEND_ACC_PUBLIC)
+    PHP_ME(H3IndexSet, toPacked, arginfo_h3indexset_void, ZEND_ACC_PUBLIC)
+    PHP_FE_END};
+
+static void php_h3_register_index_set_class(void)
 {
-    zend_long origin;
-    CoordIJ ij;
-    zval *ij_zval;
-    H3Index out;
+    zend_class_entry ce;
+
+    INIT_CLASS_ENTRY(ce, "H3IndexSet", php_h3_index_set_methods);
+    php_h3_index_set_ce = zend_register_internal_class(&ce);
+    php_h3_index_set_ce->ce_flags |= ZEND_ACC_FINAL;
+    php_h3_index_set_ce->create_object = php_h3_index_set_create;
+    // must be set before IteratorAggregate is implemented
+    php_h3_index_set_ce->get_iterator = php_h3_index_set_get_iterator;
+
+#if PHP_VERSION_ID >= 70200
+    zend_class_implements(php_h3_index_set_ce, 3, zend_ce_aggregate, zend_ce_arrayaccess, zend_ce_countable);
+#else
+    zend_class_implements(php_h3_index_set_ce, 3, zend_ce_aggregate, zend_ce_arrayaccess, spl_ce_Countable);
+#endif
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "la", &origin, &ij_zval) == FAILURE)
+    memcpy(&php_h3_index_set_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    php_h3_index_set_handlers.offset = XtOffsetOf(php_h3_index_set, std);
+    php_h3_index_set_handlers.free_obj = php_h3_index_set_free;
+    php_h3_index_set_handlers.clone_obj = php_h3_index_set_clone;
+}
+/* }}} */
+
+/* {{{ H3Polygon class
+ */
+PHP_METHOD(H3Polygon, __construct)
+{
+    zval *geopolygon_zval;
+    php_h3_polygon *polygon = Z_H3_POLYGON_P(getThis());
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "a", &geopolygon_zval) == FAILURE)
     {
         return;
     }
 
-    ij.i = Z_LVAL_P(zend_hash_str_find(Z_ARRVAL_P(ij_zval), "i", 1));
-    ij.j = Z_LVAL_P(zend_hash_str_find(Z_ARRVAL_P(ij_zval), "j", 1));
+    if (polygon->bboxes != NULL)
+    {
+        zend_throw_exception(zend_ce_exception, "H3Polygon is already constructed", 0);
+        return;
+    }
 
-    if (experimentalLocalIjToH3(origin, &ij, &out) != 0)
+    if (php_h3_geopolygon_from_zval(geopolygon_zval, &polygon->geopolygon) == FAILURE)
     {
-        RETURN_FALSE;
+        zend_throw_exception(zend_ce_exception, "Invalid polygon, expected [\"geofence\" => [[\"lat\" => ..., \"lon\" => ...], ...], \"holes\" => [...]]", 0);
+        return;
     }
-    else
+
+    polygon->bboxes = (php_h3_bbox *)calloc(polygon->geopolygon.numHoles + 1, sizeof(php_h3_bbox));
+    php_h3_bbox_from_geofence(&polygon->geopolygon.geofence, &polygon->bboxes[0]);
+    for (int i = 0; i < polygon->geopolygon.numHoles; i++)
     {
-        RETURN_LONG(out);
+        php_h3_bbox_from_geofence(&polygon->geopolygon.holes[i], &polygon->bboxes[i + 1]);
     }
 }
 
-PHP_FUNCTION(h3ToParent)
+PHP_METHOD(H3Polygon, contains)
 {
-    zend_long indexed;
-    int parentRes;
+    double lat, lon;
+    GeoCoord coord;
+    php_h3_polygon *polygon = Z_H3_POLYGON_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &parentRes) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "dd", &lat, &lon) == FAILURE)
     {
         return;
     }
 
-    H3Index h3Parent = h3ToParent(indexed, parentRes);
+    if (polygon->bboxes == NULL)
+    {
+        RETURN_FALSE;
+    }
 
-    RETURN_LONG(h3Parent);
+    coord.lat = degsToRads(lat);
+    coord.lon = degsToRads(lon);
+
+    RETURN_BOOL(php_h3_polygon_contains(polygon, &coord));
 }
 
-PHP_FUNCTION(h3ToChildren)
+PHP_METHOD(H3Polygon, getBoundingBox)
 {
-    zend_long indexed, childrenRes;
+    php_h3_polygon *polygon = Z_H3_POLYGON_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &childrenRes) == FAILURE)
+    if (zend_parse_parameters_none() == FAILURE)
     {
         return;
     }
 
-    int childrenSize = maxH3ToChildrenSize(indexed, childrenRes);
-    H3Index *h3Childrens = (H3Index *)calloc(childrenSize, sizeof(H3Index));
-    h3ToChildren(indexed, childrenRes, h3Childrens);
-
-    array_init(return_value);
-
-    for (int i = 0; i < childrenSize; i++)
+    if (polygon->bboxes == NULL)
     {
-        add_index_long(return_value, i, h3Childrens[i]);
+        RETURN_FALSE;
     }
 
-    free(h3Childrens);
+    array_init(return_value);
+    add_assoc_double(return_value, "north", radsToDegs(polygon->bboxes[0].north));
+    add_assoc_double(return_value, "south", radsToDegs(polygon->bboxes[0].south));
+    add_assoc_double(return_value, "east", radsToDegs(polygon->bboxes[0].east));
+    add_assoc_double(return_value, "west", radsToDegs(polygon->bboxes[0].west));
 }
 
-PHP_FUNCTION(maxH3ToChildrenSize)
-{
-    zend_long indexed, childrenRes;
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3polygon_construct, 0, 0, 1)
+    ZEND_ARG_ARRAY_INFO(0, polygon, 0)
+ZEND_END_ARG_INFO()
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &childrenRes) == FAILURE)
-    {
-        return;
-    }
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3polygon_contains, 0, 0, 2)
+    ZEND_ARG_INFO(0, lat)
+    ZEND_ARG_INFO(0, lon)
+ZEND_END_ARG_INFO()
 
-    int childrenSize = maxH3ToChildrenSize(indexed, childrenRes);
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3polygon_void, 0, 0, 0)
+ZEND_END_ARG_INFO()
 
-    RETURN_LONG(childrenSize);
-}
+static const zend_function_entry php_h3_polygon_methods[] = {
+    PHP_ME(H3Polygon, __construct, arginfo_h3polygon_construct, ZEND_ACC_PUBLIC)
+    PHP_ME(H3Polygon, contains, arginfo_h3polygon_contains, ZEND_ACC_PUBLIC)
+    PHP_ME(H3Polygon, getBoundingBox, arginfo_h3polygon_void, ZEND_ACC_PUBLIC)
+    PHP_FE_END};
 
-PHP_FUNCTION(h3ToCenterChild)
+static void php_h3_register_polygon_class(void)
 {
-    zend_long indexed, childrenRes;
-    H3Index centerChild;
-
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &indexed, &childrenRes) == FAILURE)
-    {
-        return;
-    }
-
-    centerChild = h3ToCenterChild(indexed, childrenRes);
+    zend_class_entry ce;
+
+    INIT_CLASS_ENTRY(ce, "H3Polygon", php_h3_polygon_methods);
+    php_h3_polygon_ce = zend_register_internal_class(&ce);
+    php_h3_polygon_ce->ce_flags |= ZEND_ACC_FINAL;
+    php_h3_polygon_ce->create_object = php_h3_polygon_create;
+
+    memcpy(&php_h3_polygon_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    php_h3_polygon_handlers.offset = XtOffsetOf(php_h3_polygon, std);
+    php_h3_polygon_handlers.free_obj = php_h3_polygon_free;
+    // the parsed polygon is immutable, there is nothing to gain from copies
+    php_h3_polygon_handlers.clone_obj = NULL;
+}
+/* }}} */
 
-    RETURN_LONG(centerChild);
+/* {{{ H3PolyfillIterator class
+ */
+PHP_METHOD(H3PolyfillIterator, __construct)
+{
 }
 
-PHP_FUNCTION(h3Compact)
+PHP_METHOD(H3PolyfillIterator, current)
 {
-    zval *compactedSet_zval;
+    php_h3_polyfill_iterator *it = Z_H3_POLYFILL_ITERATOR_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "a", &compactedSet_zval) == FAILURE)
+    if (zend_parse_parameters_none() == FAILURE)
     {
         return;
     }
 
-    int length = zend_hash_num_elements(Z_ARRVAL_P(compactedSet_zval));
-    H3Index *indexed = (H3Index *)calloc(length, sizeof(H3Index));
-
-    zval *h3Indexed_zval;
-    zend_ulong i;
-
-    ZEND_HASH_FOREACH_NUM_KEY_VAL(Z_ARRVAL_P(compactedSet_zval), i, h3Indexed_zval)
-    {
-        indexed[i] = Z_LVAL_P(h3Indexed_zval);
-    }
-    ZEND_HASH_FOREACH_END();
-
-    H3Index *outs = (H3Index *)calloc(length, sizeof(H3Index));
-    if (compact(indexed, outs, length) != 0)
-    {
-        RETURN_FALSE;
-    }
-
-    array_init(return_value);
-
-    for (int i = 0; i < length; i++)
+    if (Z_TYPE(it->current) == IS_UNDEF)
     {
-        if (outs[i] == 0)
-            break;
-        add_index_long(return_value, i, outs[i]);
+        RETURN_NULL();
     }
 
-    free(outs);
-    free(indexed);
+    RETURN_ZVAL(&it->current, 1, 0);
 }
 
-PHP_FUNCTION(uncompact)
+PHP_METHOD(H3PolyfillIterator, key)
 {
-    zend_long uncompactRes;
-    zval *compactedSet_zval;
+    php_h3_polyfill_iterator *it = Z_H3_POLYFILL_ITERATOR_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "al", &compactedSet_zval, &uncompactRes) == FAILURE)
+    if (zend_parse_parameters_none() == FAILURE)
     {
         return;
     }
 
-    int length = zend_hash_num_elements(Z_ARRVAL_P(compactedSet_zval));
-    H3Index *indexed = (H3Index *)calloc(length, sizeof(H3Index));
+    RETURN_LONG(it->key);
+}
 
-    zval *h3Indexed_zval;
-    zend_ulong i;
+PHP_METHOD(H3PolyfillIterator, next)
+{
+    php_h3_polyfill_iterator *it = Z_H3_POLYFILL_ITERATOR_P(getThis());
 
-    ZEND_HASH_FOREACH_NUM_KEY_VAL(Z_ARRVAL_P(compactedSet_zval), i, h3Indexed_zval)
+    if (zend_parse_parameters_none() == FAILURE)
     {
-        indexed[i] = Z_LVAL_P(h3Indexed_zval);
+        return;
     }
-    ZEND_HASH_FOREACH_END();
 
-    int uncompactedSize = maxUncompactSize(indexed, length, uncompactRes);
-    H3Index *outs = (H3Index *)calloc(uncompactedSize, sizeof(H3Index));
-    if (uncompact(indexed, length, outs, uncompactedSize, uncompactRes) != 0)
+    it->fresh = 0;
+    if (Z_TYPE(it->current) != IS_UNDEF)
     {
-        RETURN_FALSE;
+        it->key++;
+        php_h3_polyfill_iterator_fetch(it);
     }
+}
 
-    array_init(return_value);
+PHP_METHOD(H3PolyfillIterator, rewind)
+{
+    php_h3_polyfill_iterator *it = Z_H3_POLYFILL_ITERATOR_P(getThis());
 
-    for (int i = 0; i < uncompactedSize; i++)
+    if (zend_parse_parameters_none() == FAILURE)
     {
-        add_index_long(return_value, i, outs[i]);
+        return;
     }
 
-    free(indexed);
-    free(outs);
+    // polyfillChunked() already loaded the first chunk
+    if (!it->fresh)
+    {
+        php_h3_polyfill_iterator_rewind(it);
+    }
+    it->fresh = 0;
 }
 
-PHP_FUNCTION(maxUncompactSize)
+PHP_METHOD(H3PolyfillIterator, valid)
 {
-    zend_long uncompactRes;
-    zval *compactedSet_zval;
+    php_h3_polyfill_iterator *it = Z_H3_POLYFILL_ITERATOR_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "al", &compactedSet_zval, &uncompactRes) == FAILURE)
+    if (zend_parse_parameters_none() == FAILURE)
     {
         return;
     }
 
-    int length = zend_hash_num_elements(Z_ARRVAL_P(compactedSet_zval));
-    H3Index *indexed = (H3Index *)calloc(length, sizeof(H3Index));
-
-    zval *h3Indexed_zval;
-    zend_ulong i;
-
-    ZEND_HASH_FOREACH_NUM_KEY_VAL(Z_ARRVAL_P(compactedSet_zval), i, h3Indexed_zval)
-    {
-        indexed[i] = Z_LVAL_P(h3Indexed_zval);
-    }
-    ZEND_HASH_FOREACH_END();
+    RETURN_BOOL(Z_TYPE(it->current) != IS_UNDEF);
+}
 
-    int uncompactedSize = maxUncompactSize(indexed, length, uncompactRes);
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3polyfilliterator_void, 0, 0, 0)
+ZEND_END_ARG_INFO()
 
-    free(indexed);
+static const zend_function_entry php_h3_polyfill_iterator_methods[] = {
+    PHP_ME(H3PolyfillIterator, __construct, arginfo_h3polyfilliterator_void, ZEND_ACC_PRIVATE)
+    PHP_ME(H3PolyfillIterator, current, arginfo_h3polyfilliterator_void, ZEND_ACC_PUBLIC)
+    PHP_ME(H3PolyfillIterator, key, arginfo_h3polyfilliterator_void, ZEND_ACC_PUBLIC)
+    PHP_ME(H3PolyfillIterator, next, arginfo_h3polyfilliterator_void, ZEND_ACC_PUBLIC)
+    PHP_ME(H3PolyfillIterator, rewind, arginfo_h3polyfilliterator_void, ZEND_ACC_PUBLIC)
+    PHP_ME(H3PolyfillIterator, valid, arginfo_h3polyfilliterator_void, ZEND_ACC_PUBLIC)
+    PHP_FE_END};
 
-    RETURN_LONG(uncompactedSize);
+static void php_h3_register_polyfill_iterator_class(void)
+{
+    zend_class_entry ce;
+
+    INIT_CLASS_ENTRY(ce, "H3PolyfillIterator", php_h3_polyfill_iterator_methods);
+    php_h3_polyfill_iterator_ce = zend_register_internal_class(&ce);
+    php_h3_polyfill_iterator_ce->ce_flags |= ZEND_ACC_FINAL;
+    php_h3_polyfill_iterator_ce->create_object = php_h3_polyfill_iterator_create;
+    zend_class_implements(php_h3_polyfill_iterator_ce, 1, zend_ce_iterator);
+
+    memcpy(&php_h3_polyfill_iterator_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    php_h3_polyfill_iterator_handlers.offset = XtOffsetOf(php_h3_polyfill_iterator, std);
+    php_h3_polyfill_iterator_handlers.free_obj = php_h3_polyfill_iterator_free;
+    php_h3_polyfill_iterator_handlers.clone_obj = NULL;
 }
+/* }}} */
 
-PHP_FUNCTION(h3IndexesAreNeighbors)
+/* {{{ H3CellMap class
+ */
+PHP_METHOD(H3CellMap, __construct)
 {
-    zend_long origin, destination;
+    zend_long type = PHP_H3_CELL_MAP_INT;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &origin, &destination) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "|l", &type) == FAILURE)
     {
         return;
     }
 
-    if (h3IndexesAreNeighbors(origin, destination) == 1)
-    {
-        RETURN_TRUE;
-    }
-    else
+    if (type != PHP_H3_CELL_MAP_INT && type != PHP_H3_CELL_MAP_FLOAT)
     {
-        RETURN_FALSE;
+        zend_throw_exception(zend_ce_exception, "H3CellMap type must be H3CellMap::INT or H3CellMap::FLOAT", 0);
+        return;
     }
+
+    Z_H3_CELL_MAP_P(getThis())->type = (int)type;
 }
 
-PHP_FUNCTION(getH3UnidirectionalEdge)
+PHP_METHOD(H3CellMap, increment)
 {
-    zend_long origin, destination;
+    zend_long cell;
+    zval *by_zval = NULL;
+    php_h3_cell_map *map = Z_H3_CELL_MAP_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &origin, &destination) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l|z", &cell, &by_zval) == FAILURE)
     {
         return;
     }
 
-    H3Index index = getH3UnidirectionalEdge(origin, destination);
-    if (index == 0)
+    if (cell == 0)
     {
-        RETURN_FALSE;
+        RETURN_NULL();
     }
 
-    RETURN_LONG(index);
+    php_h3_cell_value *value = php_h3_cell_map_add(map, cell, by_zval ? zval_get_long(by_zval) : 1, by_zval ? zval_get_double(by_zval) : 1.0);
+    php_h3_cell_map_value_zval(map, value, return_value);
 }
 
-PHP_FUNCTION(h3UnidirectionalEdgeIsValid)
+// Adds 1, one number, or the aligned entry of an array or packed float64
+// string of amounts to every cell of the set.
+PHP_METHOD(H3CellMap, incrementBatch)
 {
-    zend_long edge;
-
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    zval *h3Set_zval, *by_zval = NULL;
+    php_h3_cell_map *map = Z_H3_CELL_MAP_P(getThis());
+    php_h3_input in;
+    double *amounts = NULL;
+    size_t amounts_count;
+    zend_long by_long = 1;
+    double by_double = 1.0;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "z|z", &h3Set_zval, &by_zval) == FAILURE)
     {
         return;
     }
 
-    if (h3UnidirectionalEdgeIsValid(edge) == 1)
-    {
-        RETURN_TRUE;
-    }
-    else
+    if (php_h3_input_init(&in, h3Set_zval) == FAILURE)
     {
         RETURN_FALSE;
     }
-}
 
-PHP_FUNCTION(getOriginH3IndexFromUnidirectionalEdge)
-{
-    zend_long edge;
+    if (by_zval != NULL && (Z_TYPE_P(by_zval) == IS_ARRAY || Z_TYPE_P(by_zval) == IS_STRING))
+    {
+        amounts = php_h3_doubles_from_zval(by_zval, &amounts_count);
+        if (amounts == NULL || amounts_count != in.length)
+        {
+            if (amounts != NULL)
+            {
+                php_error_docref(NULL, E_WARNING, "Cells and amounts must have the same number of elements");
+            }
+            free(amounts);
+            php_h3_input_free(&in);
+            RETURN_FALSE;
+        }
+    }
+    else if (by_zval != NULL && Z_TYPE_P(by_zval) != IS_NULL)
+    {
+        by_long = zval_get_long(by_zval);
+        by_double = zval_get_double(by_zval);
+    }
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    for (size_t i = 0; i < in.length; i++)
     {
-        return;
+        if (in.indexes[i] == 0)
+        {
+            continue;
+        }
+        if (amounts != NULL)
+        {
+            by_long = (zend_long)amounts[i];
+            by_double = amounts[i];
+        }
+        php_h3_cell_map_add(map, in.indexes[i], by_long, by_double);
     }
 
-    H3Index index = getOriginH3IndexFromUnidirectionalEdge(edge);
+    free(amounts);
+    php_h3_input_free(&in);
 
-    RETURN_LONG(index);
+    RETURN_TRUE;
 }
 
-PHP_FUNCTION(getDestinationH3IndexFromUnidirectionalEdge)
+// Counts points per cell, reading coordinates like geoToH3Batch() does.
+// Returns the number of points binned, leaving out those geoToH3() rejects.
+PHP_METHOD(H3CellMap, binPoints)
 {
-    zend_long edge;
+    zval *lats_zval, *lons_zval;
+    char *packed;
+    size_t packed_len, count, binned = 0;
+    zend_long resolution;
+    double *coords;
+    php_h3_cell_map *map = Z_H3_CELL_MAP_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    if (ZEND_NUM_ARGS() > 0 && Z_TYPE_P(ZEND_CALL_ARG(execute_data, 1)) == IS_STRING)
     {
-        return;
-    }
-
-    H3Index index = getDestinationH3IndexFromUnidirectionalEdge(edge);
+        if (zend_parse_parameters(ZEND_NUM_ARGS(), "sl", &packed, &packed_len, &resolution) == FAILURE)
+        {
+            return;
+        }
 
-    RETURN_LONG(index);
-}
+        coords = php_h3_coords_from_packed(packed, packed_len, &count);
+    }
+    else
+    {
+        if (zend_parse_parameters(ZEND_NUM_ARGS(), "aal", &lats_zval, &lons_zval, &resolution) == FAILURE)
+        {
+            return;
+        }
 
-PHP_FUNCTION(getH3IndexesFromUnidirectionalEdge)
-{
-    zend_long edge;
+        coords = php_h3_coords_from_arrays(lats_zval, lons_zval, &count);
+    }
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    if (coords == NULL)
     {
-        return;
+        RETURN_FALSE;
     }
 
-    H3Index originDestination[2];
-    getH3IndexesFromUnidirectionalEdge(edge, originDestination);
+    if (resolution < 0 || resolution > MAX_H3_RES)
+    {
+        free(coords);
+        php_error_docref(NULL, E_WARNING, "Resolution must be between 0 and 15");
+        RETURN_FALSE;
+    }
 
-    array_init(return_value);
+    php_h3_degs_to_rads_buffer(coords, count * 2);
 
-    for (int i = 0; i < 2; i++)
+    for (size_t i = 0; i < count; i++)
     {
-        add_index_long(return_value, i, originDestination[i]);
+        GeoCoord location;
+        location.lat = coords[i * 2];
+        location.lon = coords[i * 2 + 1];
+
+        H3Index cell = geoToH3(&location, resolution);
+        if (cell != 0)
+        {
+            php_h3_cell_map_add(map, cell, 1, 1.0);
+            binned++;
+        }
     }
+
+    free(coords);
+
+    RETURN_LONG(binned);
 }
 
-PHP_FUNCTION(getH3UnidirectionalEdgesFromHexagon)
+PHP_METHOD(H3CellMap, get)
 {
-    zend_long edge;
+    zend_long cell;
+    zval *default_zval = NULL;
+    php_h3_cell_map *map = Z_H3_CELL_MAP_P(getThis());
+    php_h3_cell_value *value;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l|z", &cell, &default_zval) == FAILURE)
     {
         return;
     }
 
-    H3Index edges[6];
-    getH3UnidirectionalEdgesFromHexagon(edge, edges);
-
-    array_init(return_value);
+    if ((value = php_h3_cell_map_find(map, cell)) != NULL)
+    {
+        php_h3_cell_map_value_zval(map, value, return_value);
+        return;
+    }
 
-    for (int i = 0; i < 6; i++)
+    if (default_zval != NULL)
     {
-        add_index_long(return_value, i, edges[i]);
+        RETURN_ZVAL(default_zval, 1, 0);
     }
 }
 
-PHP_FUNCTION(getH3UnidirectionalEdgeBoundary)
+PHP_METHOD(H3CellMap, set)
 {
-    zend_long edge;
+    zend_long cell;
+    zval *value_zval;
+    php_h3_cell_map *map = Z_H3_CELL_MAP_P(getThis());
+    php_h3_cell_value *value;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "lz", &cell, &value_zval) == FAILURE)
     {
         return;
     }
 
-    // Get the vertices of the H3 index.
-    GeoBoundary boundary;
-    getH3UnidirectionalEdgeBoundary(edge, &boundary);
-
-    array_init(return_value);
-    // Indexes can have different number of vertices under some cases,
-    // which is why boundary.numVerts is needed.
-    for (int v = 0; v < boundary.numVerts; v++)
+    if (cell == 0)
     {
-        double lat, lon;
-
-        lat = radsToDegs(boundary.verts[v].lat);
-        lon = radsToDegs(boundary.verts[v].lon);
-
-        zval lat_lon_arr;
-        array_init(&lat_lon_arr);
-
-        add_assoc_double(&lat_lon_arr, "lat", lat);
-        add_assoc_double(&lat_lon_arr, "lon", lon);
+        return;
+    }
 
-        add_index_zval(return_value, v, &lat_lon_arr);
+    value = php_h3_cell_map_upsert(map, cell);
+    if (map->type == PHP_H3_CELL_MAP_FLOAT)
+    {
+        value->d = zval_get_double(value_zval);
+    }
+    else
+    {
+        value->l = zval_get_long(value_zval);
     }
 }
 
-PHP_FUNCTION(polyfill)
+PHP_METHOD(H3CellMap, has)
 {
-    zval *geopolygon_zval;
-    zend_long res;
-    int polyfillsize;
+    zend_long cell;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "al", &geopolygon_zval, &res) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &cell) == FAILURE)
     {
         return;
     }
 
-    zval *geofence_zval = zend_hash_str_find(Z_ARRVAL_P(geopolygon_zval), "geofence", 8);
-    zval *holes_zval = zend_hash_str_find(Z_ARRVAL_P(geopolygon_zval), "holes", 5);
-
-    int geofence_verts_num = zend_hash_num_elements(Z_ARRVAL_P(geofence_zval));
-    GeoCoord *geofence_verts = (GeoCoord *)calloc(geofence_verts_num, sizeof(GeoCoord));
+    RETURN_BOOL(php_h3_cell_map_find(Z_H3_CELL_MAP_P(getThis()), cell) != NULL);
+}
 
-    zval *vert_zval;
-    zend_ulong i, j;
+PHP_METHOD(H3CellMap, remove)
+{
+    zend_long cell;
 
-    ZEND_HASH_FOREACH_NUM_KEY_VAL(Z_ARRVAL_P(geofence_zval), i, vert_zval)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &cell) == FAILURE)
     {
-        GeoCoord vert;
-        vert.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(vert_zval), "lat", 3)));
-        vert.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(vert_zval), "lon", 3)));
-        geofence_verts[i] = vert;
+        return;
     }
-    ZEND_HASH_FOREACH_END();
 
-    Geofence geoface_geoface = {geofence_verts_num, geofence_verts};
+    RETURN_BOOL(php_h3_cell_map_remove(Z_H3_CELL_MAP_P(getThis()), cell) == SUCCESS);
+}
 
-    int holesnum = zend_hash_num_elements(Z_ARRVAL_P(holes_zval));
-    Geofence *holes_geofaces = (Geofence *)calloc(holesnum, sizeof(Geofence));
+// Adds every value of another map to this one.
+PHP_METHOD(H3CellMap, merge)
+{
+    zval *other_zval;
+    php_h3_cell_map *map = Z_H3_CELL_MAP_P(getThis());
+    php_h3_cell_map *other;
 
-    zval *holesnum_geoface_zval;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "O", &other_zval, php_h3_cell_map_ce) == FAILURE)
+    {
+        return;
+    }
 
-    ZEND_HASH_FOREACH_NUM_KEY_VAL(Z_ARRVAL_P(holes_zval), i, holesnum_geoface_zval)
+    other = Z_H3_CELL_MAP_P(other_zval);
+    if (other == map)
     {
-        int holes_vertsnum = zend_hash_num_elements(Z_ARRVAL_P(holesnum_geoface_zval));
-        GeoCoord *holes_verts = (GeoCoord *)calloc(holes_vertsnum, sizeof(GeoCoord));
-        zval *holes_verts_zval;
-        ZEND_HASH_FOREACH_NUM_KEY_VAL(Z_ARRVAL_P(holesnum_geoface_zval), j, holes_verts_zval)
+        // adding a map to itself doubles every value without inserting
+        for (size_t i = 0; i < map->capacity; i++)
         {
-            GeoCoord vert;
-            vert.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(holes_verts_zval), "lat", 3)));
-            vert.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(holes_verts_zval), "lon", 3)));
-            holes_verts[j] = vert;
+            if (map->type == PHP_H3_CELL_MAP_FLOAT)
+            {
+                map->values[i].d *= 2;
+            }
+            else
+            {
+                map->values[i].l *= 2;
+            }
         }
-        ZEND_HASH_FOREACH_END();
-        Geofence holes_geoface = {holes_vertsnum, holes_verts};
-        holes_geofaces[i] = holes_geoface;
-        free(holes_verts);
+        return;
     }
-    ZEND_HASH_FOREACH_END();
 
-    GeoPolygon geopolygon = {geoface_geoface, holesnum, holes_geofaces};
-
-    polyfillsize = maxPolyfillSize(&geopolygon, res);
-    H3Index *polyfillOut = (H3Index *)calloc(polyfillsize, sizeof(H3Index));
-    polyfill(&geopolygon, res, polyfillOut);
-
-    array_init(return_value);
-
-    for (int i = 0; i < polyfillsize; i++)
+    for (size_t i = 0; i < other->capacity; i++)
     {
-        add_index_long(return_value, i, polyfillOut[i]);
+        if (other->keys[i] == 0)
+        {
+            continue;
+        }
+        if (other->type == PHP_H3_CELL_MAP_FLOAT)
+        {
+            php_h3_cell_map_add(map, other->keys[i], (zend_long)other->values[i].d, other->values[i].d);
+        }
+        else
+        {
+            php_h3_cell_map_add(map, other->keys[i], other->values[i].l, (double)other->values[i].l);
+        }
     }
-
-    free(geofence_verts);
-    free(holes_geofaces);
-    free(polyfillOut);
 }
 
-PHP_FUNCTION(maxPolyfillSize)
+PHP_METHOD(H3CellMap, count)
 {
-    zval *geopolygon_zval;
-    zend_long res;
-    int polyfillsize;
-
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "al", &geopolygon_zval, &res) == FAILURE)
+    if (zend_parse_parameters_none() == FAILURE)
     {
         return;
     }
 
-    zval *geofence_zval = zend_hash_str_find(Z_ARRVAL_P(geopolygon_zval), "geofence", 8);
-    zval *holes_zval = zend_hash_str_find(Z_ARRVAL_P(geopolygon_zval), "holes", 5);
-
-    int geofence_verts_num = zend_hash_num_elements(Z_ARRVAL_P(geofence_zval));
-    GeoCoord *geofence_verts = (GeoCoord *)calloc(geofence_verts_num, sizeof(GeoCoord));
-
-    zval *vert_zval;
-    zend_ulong i, j;
+    RETURN_LONG(Z_H3_CELL_MAP_P(getThis())->count);
+}
 
-    ZEND_HASH_FOREACH_NUM_KEY_VAL(Z_ARRVAL_P(geofence_zval), i, vert_zval)
+PHP_METHOD(H3CellMap, getIterator)
+{
+    if (zend_parse_parameters_none() == FAILURE)
     {
-        GeoCoord vert;
-        vert.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(vert_zval), "lat", 3)));
-        vert.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(vert_zval), "lon", 3)));
-        geofence_verts[i] = vert;
+        return;
     }
-    ZEND_HASH_FOREACH_END();
 
-    Geofence geoface_geoface = {geofence_verts_num, geofence_verts};
+#if PHP_VERSION_ID >= 80000
+    zend_create_internal_iterator_zval(return_value, getThis());
+#else
+    ZVAL_COPY(return_value, getThis());
+#endif
+}
 
-    int holesnum = zend_hash_num_elements(Z_ARRVAL_P(holes_zval));
-    Geofence *holes_geofaces = (Geofence *)calloc(holesnum, sizeof(Geofence));
+PHP_METHOD(H3CellMap, keys)
+{
+    zend_long format = PHP_H3_FORMAT_ARRAY;
+    php_h3_cell_map *map = Z_H3_CELL_MAP_P(getThis());
+    php_h3_output out;
+    size_t count = 0;
 
-    zval *holesnum_geoface_zval;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "|l", &format) == FAILURE)
+    {
+        return;
+    }
 
-    ZEND_HASH_FOREACH_NUM_KEY_VAL(Z_ARRVAL_P(holes_zval), i, holesnum_geoface_zval)
+    H3Index *outs = php_h3_output_init(&out, format, map->count);
+    for (size_t i = 0; i < map->capacity; i++)
     {
-        int holes_vertsnum = zend_hash_num_elements(Z_ARRVAL_P(holesnum_geoface_zval));
-        GeoCoord *holes_verts = (GeoCoord *)calloc(holes_vertsnum, sizeof(GeoCoord));
-        zval *holes_verts_zval;
-        ZEND_HASH_FOREACH_NUM_KEY_VAL(Z_ARRVAL_P(holesnum_geoface_zval), j, holes_verts_zval)
+        if (map->keys[i] != 0)
         {
-            GeoCoord vert;
-            vert.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(holes_verts_zval), "lat", 3)));
-            vert.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(holes_verts_zval), "lon", 3)));
-            holes_verts[j] = vert;
+            outs[count++] = map->keys[i];
         }
-        ZEND_HASH_FOREACH_END();
-        Geofence holes_geoface = {holes_vertsnum, holes_verts};
-        holes_geofaces[i] = holes_geoface;
-        free(holes_verts);
     }
-    ZEND_HASH_FOREACH_END();
-
-    GeoPolygon geopolygon = {geoface_geoface, holesnum, holes_geofaces};
-
-    polyfillsize = maxPolyfillSize(&geopolygon, res);
-
-    free(geofence_verts);
-    free(holes_geofaces);
 
-    RETURN_LONG(polyfillsize);
+    php_h3_output_return(&out, count, return_value);
 }
 
-PHP_FUNCTION(h3SetToLinkedGeo)
+PHP_METHOD(H3CellMap, toArray)
 {
-    zval *h3set_zval;
-    LinkedGeoPolygon polygon;
+    php_h3_cell_map *map = Z_H3_CELL_MAP_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "a", &h3set_zval) == FAILURE)
+    if (zend_parse_parameters_none() == FAILURE)
     {
         return;
     }
 
-    int numHexes = zend_hash_num_elements(Z_ARRVAL_P(h3set_zval));
-    H3Index *h3set = (H3Index *)calloc(numHexes, sizeof(H3Index));
+    array_init_size(return_value, map->count);
 
-    zval *h3Indexed_zval;
-    zend_ulong i;
-
-    ZEND_HASH_FOREACH_NUM_KEY_VAL(Z_ARRVAL_P(h3set_zval), i, h3Indexed_zval)
-    {
-        h3set[i] = Z_LVAL_P(h3Indexed_zval);
-    }
-    ZEND_HASH_FOREACH_END();
-
-    h3SetToLinkedGeo(h3set, numHexes, &polygon);
-
-    free(h3set);
-
-    LinkedGeoPolygon *polygonloop = &polygon;
-    array_init(return_value);
-
-    while (polygonloop != NULL)
+    for (size_t i = 0; i < map->capacity; i++)
     {
-        zval geoloop_zval;
-        array_init(&geoloop_zval);
-
-        LinkedGeoLoop *geoloop = polygonloop->first;
+        zval value_zval;
 
-        while (geoloop != NULL)
+        if (map->keys[i] == 0)
         {
-            zval geocoord_zval;
-            array_init(&geocoord_zval);
-
-            LinkedGeoCoord *coordloop = geoloop->first;
-
-            while (coordloop != NULL)
-            {
-                zval vertex_zval;
-                array_init(&vertex_zval);
-
-                double lat, lon;
-
-                lat = radsToDegs(coordloop->vertex.lat);
-                lon = radsToDegs(coordloop->vertex.lon);
+            continue;
+        }
+        php_h3_cell_map_value_zval(map, &map->values[i], &value_zval);
+        zend_hash_index_update(Z_ARRVAL_P(return_value), map->keys[i], &value_zval);
+    }
+}
 
-                add_assoc_double(&vertex_zval, "lat", lat);
-                add_assoc_double(&vertex_zval, "lon", lon);
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3cellmap_construct, 0, 0, 0)
+    ZEND_ARG_INFO(0, type)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3cellmap_void, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3cellmap_cell, 0, 0, 1)
+    ZEND_ARG_INFO(0, cell)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3cellmap_increment, 0, 0, 1)
+    ZEND_ARG_INFO(0, cell)
+    ZEND_ARG_INFO(0, by)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3cellmap_increment_batch, 0, 0, 1)
+    ZEND_ARG_INFO(0, cells)
+    ZEND_ARG_INFO(0, by)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3cellmap_bin_points, 0, 0, 2)
+    ZEND_ARG_INFO(0, lats)
+    ZEND_ARG_INFO(0, lons)
+    ZEND_ARG_INFO(0, res)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3cellmap_get, 0, 0, 1)
+    ZEND_ARG_INFO(0, cell)
+    ZEND_ARG_INFO(0, default)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3cellmap_set, 0, 0, 2)
+    ZEND_ARG_INFO(0, cell)
+    ZEND_ARG_INFO(0, value)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3cellmap_merge, 0, 0, 1)
+    ZEND_ARG_OBJ_INFO(0, other, H3CellMap, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3cellmap_keys, 0, 0, 0)
+    ZEND_ARG_INFO(0, format)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry php_h3_cell_map_methods[] = {
+    PHP_ME(H3CellMap, __construct, arginfo_h3cellmap_construct, ZEND_ACC_PUBLIC)
+    PHP_ME(H3CellMap, increment, arginfo_h3cellmap_increment, ZEND_ACC_PUBLIC)
+    PHP_ME(H3CellMap, incrementBatch, arginfo_h3cellmap_increment_batch, ZEND_ACC_PUBLIC)
+    PHP_ME(H3CellMap, binPoints, arginfo_h3cellmap_bin_points, ZEND_ACC_PUBLIC)
+    PHP_ME(H3CellMap, get, arginfo_h3cellmap_get, ZEND_ACC_PUBLIC)
+    PHP_ME(H3CellMap, set, arginfo_h3cellmap_set, ZEND_ACC_PUBLIC)
+    PHP_ME(H3CellMap, has, arginfo_h3cellmap_cell, ZEND_ACC_PUBLIC)
+    PHP_ME(H3CellMap, remove, arginfo_h3cellmap_cell, ZEND_ACC_PUBLIC)
+    PHP_ME(H3CellMap, merge, arginfo_h3cellmap_merge, ZEND_ACC_PUBLIC)
+    PHP_ME(H3CellMap, count, arginfo_h3cellmap_void, ZEND_ACC_PUBLIC)
+    PHP_ME(H3CellMap, getIterator, arginfo_h3cellmap_void, ZEND_ACC_PUBLIC)
+    PHP_ME(H3CellMap, keys, arginfo_h3cellmap_keys, ZEND_ACC_PUBLIC)
+    PHP_ME(H3CellMap, toArray, arginfo_h3cellmap_void, ZEND_ACC_PUBLIC)
+    PHP_FE_END};
+
+static void php_h3_register_cell_map_class(void)
+{
+    zend_class_entry ce;
+
+    INIT_CLASS_ENTRY(ce, "H3CellMap", php_h3_cell_map_methods);
+    php_h3_cell_map_ce = zend_register_internal_class(&ce);
+    php_h3_cell_map_ce->ce_flags |= ZEND_ACC_FINAL;
+    php_h3_cell_map_ce->create_object = php_h3_cell_map_create;
+    // must be set before IteratorAggregate is implemented
+    php_h3_cell_map_ce->get_iterator = php_h3_cell_map_get_iterator;
+
+#if PHP_VERSION_ID >= 70200
+    zend_class_implements(php_h3_cell_map_ce, 2, zend_ce_aggregate, zend_ce_countable);
+#else
+    zend_class_implements(php_h3_cell_map_ce, 2, zend_ce_aggregate, spl_ce_Countable);
+#endif
 
-                add_next_index_zval(&geocoord_zval, &vertex_zval);
+    zend_declare_class_constant_long(php_h3_cell_map_ce, "INT", sizeof("INT") - 1, PHP_H3_CELL_MAP_INT);
+    zend_declare_class_constant_long(php_h3_cell_map_ce, "FLOAT", sizeof("FLOAT") - 1, PHP_H3_CELL_MAP_FLOAT);
 
-                coordloop = coordloop->next;
-            }
+    memcpy(&php_h3_cell_map_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    php_h3_cell_map_handlers.offset = XtOffsetOf(php_h3_cell_map, std);
+    php_h3_cell_map_handlers.free_obj = php_h3_cell_map_free;
+    php_h3_cell_map_handlers.clone_obj = php_h3_cell_map_clone;
+}
+/* }}} */
 
-            add_next_index_zval(&geoloop_zval, &geocoord_zval);
+/* {{{ H3PointIndex class
+ */
+PHP_METHOD(H3PointIndex, __construct)
+{
+    zval *lats_zval, *lons_zval;
+    char *packed;
+    size_t packed_len, count;
+    zend_long resolution;
+    double *coords;
+    php_h3_point_index *index = Z_H3_POINT_INDEX_P(getThis());
 
-            geoloop = geoloop->next;
+    if (ZEND_NUM_ARGS() > 0 && Z_TYPE_P(ZEND_CALL_ARG(execute_data, 1)) == IS_STRING)
+    {
+        if (zend_parse_parameters(ZEND_NUM_ARGS(), "sl", &packed, &packed_len, &resolution) == FAILURE)
+        {
+            return;
         }
 
-        add_next_index_zval(return_value, &geoloop_zval);
-
-        polygonloop = polygonloop->next;
+        coords = php_h3_coords_from_packed(packed, packed_len, &count);
     }
+    else
+    {
+        if (zend_parse_parameters(ZEND_NUM_ARGS(), "aal", &lats_zval, &lons_zval, &resolution) == FAILURE)
+        {
+            return;
+        }
 
-    destroyLinkedPolygon(&polygon);
-}
+        coords = php_h3_coords_from_arrays(lats_zval, lons_zval, &count);
+    }
 
-PHP_FUNCTION(degsToRads)
-{
-    double lat_lon;
+    if (index->cells != NULL)
+    {
+        free(coords);
+        zend_throw_exception(zend_ce_exception, "H3PointIndex is already constructed", 0);
+        return;
+    }
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "d", &lat_lon) == FAILURE)
+    if (coords == NULL || count > UINT32_MAX)
     {
+        free(coords);
+        zend_throw_exception(zend_ce_exception, "Invalid points, expected parallel lat/lon arrays or a packed float64 lat/lon string", 0);
         return;
     }
 
-    double radians_lat_lon = degsToRads(lat_lon);
+    if (resolution < 0 || resolution > MAX_H3_RES)
+    {
+        free(coords);
+        zend_throw_exception(zend_ce_exception, "Resolution must be between 0 and 15", 0);
+        return;
+    }
 
-    RETURN_DOUBLE(radians_lat_lon);
+    php_h3_degs_to_rads_buffer(coords, count * 2);
+    php_h3_point_index_build(index, coords, count, (int)resolution);
+    free(coords);
 }
 
-PHP_FUNCTION(radsToDegs)
+// Runs a query and hands back the ids of the hits closest first, either as
+// [id => km] or as packed uint64 ids.
+static void php_h3_point_index_query(INTERNAL_FUNCTION_PARAMETERS, php_h3_point_index *index, php_h3_point_query *query, double lat, double lon, zend_long format)
 {
-    double lat_lon;
+    GeoCoord origin;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "d", &lat_lon) == FAILURE)
+    if (index->cells == NULL)
     {
+        zend_throw_exception(zend_ce_exception, "H3PointIndex is not constructed", 0);
         return;
     }
 
-    double degrees_lat_lon = radsToDegs(lat_lon);
-
-    RETURN_DOUBLE(degrees_lat_lon);
-}
+    if (format != PHP_H3_FORMAT_ARRAY && format != PHP_H3_FORMAT_PACKED)
+    {
+        php_error_docref(NULL, E_WARNING, "Format must be H3_FORMAT_ARRAY or H3_FORMAT_PACKED");
+        RETURN_FALSE;
+    }
 
-PHP_FUNCTION(hexAreaKm2)
-{
-    zend_long res;
+    origin.lat = degsToRads(lat);
+    origin.lon = degsToRads(lon);
+    php_h3_point_index_search(index, query, &origin);
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &res) == FAILURE)
+    if (format == PHP_H3_FORMAT_PACKED)
     {
+        php_h3_output out;
+        H3Index *ids = php_h3_output_init(&out, format, query->count);
+
+        for (size_t i = 0; i < query->count; i++)
+        {
+            ids[i] = index->hits[i].id;
+        }
+
+        php_h3_output_return(&out, query->count, return_value);
         return;
     }
 
-    double kilometers2 = hexAreaKm2(res);
-
-    RETURN_DOUBLE(kilometers2);
+    array_init_size(return_value, query->count);
+    for (size_t i = 0; i < query->count; i++)
+    {
+        add_index_double(return_value, index->hits[i].id, index->hits[i].km);
+    }
 }
 
-PHP_FUNCTION(hexAreaM2)
+PHP_METHOD(H3PointIndex, radius)
 {
-    zend_long res;
+    double lat, lon, km;
+    zend_long format = PHP_H3_FORMAT_ARRAY;
+    php_h3_point_query query = {0};
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &res) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ddd|l", &lat, &lon, &km, &format) == FAILURE)
     {
         return;
     }
 
-    double meters2 = hexAreaM2(res);
-
-    RETURN_DOUBLE(meters2);
+    query.max_km = km;
+    php_h3_point_index_query(INTERNAL_FUNCTION_PARAM_PASSTHRU, Z_H3_POINT_INDEX_P(getThis()), &query, lat, lon, format);
 }
 
-PHP_FUNCTION(cellAreaKm2)
+PHP_METHOD(H3PointIndex, kNearest)
 {
-    zend_long h;
+    double lat, lon, max_km = INFINITY;
+    zend_long k, format = PHP_H3_FORMAT_ARRAY;
+    php_h3_point_query query = {0};
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &h) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ddl|dl", &lat, &lon, &k, &max_km, &format) == FAILURE)
     {
         return;
     }
 
-    double kilometers2 = cellAreaKm2(h);
+    if (k <= 0)
+    {
+        if (format == PHP_H3_FORMAT_PACKED)
+        {
+            RETURN_EMPTY_STRING();
+        }
+        array_init(return_value);
+        return;
+    }
 
-    RETURN_DOUBLE(kilometers2);
+    query.k = (size_t)k;
+    query.max_km = max_km;
+    php_h3_point_index_query(INTERNAL_FUNCTION_PARAM_PASSTHRU, Z_H3_POINT_INDEX_P(getThis()), &query, lat, lon, format);
 }
 
-PHP_FUNCTION(cellAreaM2)
+PHP_METHOD(H3PointIndex, count)
 {
-    zend_long h;
-
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &h) == FAILURE)
+    if (zend_parse_parameters_none() == FAILURE)
     {
         return;
     }
 
-    double meters2 = cellAreaM2(h);
-
-    RETURN_DOUBLE(meters2);
+    RETURN_LONG(Z_H3_POINT_INDEX_P(getThis())->point_count);
 }
 
-PHP_FUNCTION(cellAreaRads2)
+PHP_METHOD(H3PointIndex, getResolution)
 {
-    zend_long h;
-
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &h) == FAILURE)
+    if (zend_parse_parameters_none() == FAILURE)
     {
         return;
     }
 
-    double rads2 = cellAreaRads2(h);
-
-    RETURN_DOUBLE(rads2);
+    RETURN_LONG(Z_H3_POINT_INDEX_P(getThis())->res);
 }
 
-PHP_FUNCTION(edgeLengthKm)
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3pointindex_construct, 0, 0, 2)
+    ZEND_ARG_INFO(0, lats)
+    ZEND_ARG_INFO(0, lons)
+    ZEND_ARG_INFO(0, res)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3pointindex_void, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3pointindex_radius, 0, 0, 3)
+    ZEND_ARG_INFO(0, lat)
+    ZEND_ARG_INFO(0, lon)
+    ZEND_ARG_INFO(0, km)
+    ZEND_ARG_INFO(0, format)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3pointindex_k_nearest, 0, 0, 3)
+    ZEND_ARG_INFO(0, lat)
+    ZEND_ARG_INFO(0, lon)
+    ZEND_ARG_INFO(0, k)
+    ZEND_ARG_INFO(0, maxKm)
+    ZEND_ARG_INFO(0, format)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry php_h3_point_index_methods[] = {
+    PHP_ME(H3PointIndex, __construct, arginfo_h3pointindex_construct, ZEND_ACC_PUBLIC)
+    PHP_ME(H3PointIndex, radius, arginfo_h3pointindex_radius, ZEND_ACC_PUBLIC)
+    PHP_ME(H3PointIndex, kNearest, arginfo_h3pointindex_k_nearest, ZEND_ACC_PUBLIC)
+    PHP_ME(H3PointIndex, count, arginfo_h3pointindex_void, ZEND_ACC_PUBLIC)
+    PHP_ME(H3PointIndex, getResolution, arginfo_h3pointindex_void, ZEND_ACC_PUBLIC)
+    PHP_FE_END};
+
+static void php_h3_register_point_index_class(void)
 {
-    zend_long res;
+    zend_class_entry ce;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &res) == FAILURE)
-    {
-        return;
-    }
+    INIT_CLASS_ENTRY(ce, "H3PointIndex", php_h3_point_index_methods);
+    php_h3_point_index_ce = zend_register_internal_class(&ce);
+    php_h3_point_index_ce->ce_flags |= ZEND_ACC_FINAL;
+    php_h3_point_index_ce->create_object = php_h3_point_index_create;
 
-    double kilometers = edgeLengthKm(res);
+#if PHP_VERSION_ID >= 70200
+    zend_class_implements(php_h3_point_index_ce, 1, zend_ce_countable);
+#else
+    zend_class_implements(php_h3_point_index_ce, 1, spl_ce_Countable);
+#endif
 
-    RETURN_DOUBLE(kilometers);
+    memcpy(&php_h3_point_index_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    php_h3_point_index_handlers.offset = XtOffsetOf(php_h3_point_index, std);
+    php_h3_point_index_handlers.free_obj = php_h3_point_index_free;
+    php_h3_point_index_handlers.clone_obj = NULL;
 }
+/* }}} */
 
-PHP_FUNCTION(edgeLengthM)
+/* {{{ H3EntityIndex class
+ */
+PHP_METHOD(H3EntityIndex, __construct)
 {
-    zend_long res;
+    zend_long resolution;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &res) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &resolution) == FAILURE)
     {
         return;
     }
 
-    double meters = edgeLengthM(res);
+    if (resolution < 0 || resolution > MAX_H3_RES)
+    {
+        zend_throw_exception(zend_ce_exception, "Resolution must be between 0 and 15", 0);
+        return;
+    }
 
-    RETURN_DOUBLE(meters);
+    Z_H3_ENTITY_INDEX_P(getThis())->res = (int)resolution;
 }
 
-PHP_FUNCTION(exactEdgeLengthKm)
+PHP_METHOD(H3EntityIndex, set)
 {
-    zend_long edge;
+    zend_long id;
+    double lat, lon;
+    GeoCoord location;
+    php_h3_entity_index *index = Z_H3_ENTITY_INDEX_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ldd", &id, &lat, &lon) == FAILURE)
     {
         return;
     }
 
-    double kilometers = exactEdgeLengthKm(edge);
+    location.lat = degsToRads(lat);
+    location.lon = degsToRads(lon);
 
-    RETURN_DOUBLE(kilometers);
+    H3Index cell = geoToH3(&location, index->res);
+    if (cell == 0)
+    {
+        RETURN_FALSE;
+    }
+
+    php_h3_entity_index_set(index, id, cell);
+
+    RETURN_LONG(cell);
 }
 
-PHP_FUNCTION(exactEdgeLengthM)
+PHP_METHOD(H3EntityIndex, setCell)
 {
-    zend_long edge;
+    zend_long id, cell;
+    php_h3_entity_index *index = Z_H3_ENTITY_INDEX_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll", &id, &cell) == FAILURE)
     {
         return;
     }
 
-    double meters = exactEdgeLengthM(edge);
+    if (!h3IsValid(cell) || h3GetResolution(cell) != index->res)
+    {
+        php_error_docref(NULL, E_WARNING, "Cell must be a valid index at resolution %d", index->res);
+        RETURN_FALSE;
+    }
 
-    RETURN_DOUBLE(meters);
+    php_h3_entity_index_set(index, id, cell);
+
+    RETURN_TRUE;
 }
 
-PHP_FUNCTION(exactEdgeLengthRads)
+PHP_METHOD(H3EntityIndex, remove)
 {
-    zend_long edge;
+    zend_long id;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &edge) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &id) == FAILURE)
     {
         return;
     }
 
-    double rads = exactEdgeLengthM(edge);
-
-    RETURN_DOUBLE(rads);
+    RETURN_BOOL(php_h3_entity_index_remove(Z_H3_ENTITY_INDEX_P(getThis()), id) == SUCCESS);
 }
 
-PHP_FUNCTION(numHexagons)
+PHP_METHOD(H3EntityIndex, get)
 {
-    zend_long res;
+    zend_long id;
+    php_h3_entity_index *index = Z_H3_ENTITY_INDEX_P(getThis());
+    zval *found;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &res) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &id) == FAILURE)
     {
         return;
     }
 
-    zend_long number_of_indexes = numHexagons(res);
+    if ((found = zend_hash_index_find(&index->ids, id)) == NULL)
+    {
+        RETURN_NULL();
+    }
 
-    RETURN_LONG(number_of_indexes);
+    RETURN_LONG(index->records[Z_LVAL_P(found)].cell);
 }
 
-PHP_FUNCTION(getRes0Indexes)
+PHP_METHOD(H3EntityIndex, has)
 {
-    int indexcount = res0IndexCount();
-    H3Index *outs = (H3Index *)calloc(indexcount, sizeof(H3Index));
+    zend_long id;
 
-    getRes0Indexes(outs);
-
-    array_init(return_value);
-    for (int i = 0; i < indexcount; i++)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &id) == FAILURE)
     {
-        add_index_long(return_value, i, outs[i]);
+        return;
     }
 
-    free(outs);
+    RETURN_BOOL(zend_hash_index_exists(&Z_H3_ENTITY_INDEX_P(getThis())->ids, id));
 }
 
-PHP_FUNCTION(res0IndexCount)
+PHP_METHOD(H3EntityIndex, count)
 {
-    RETURN_LONG(res0IndexCount());
+    if (zend_parse_parameters_none() == FAILURE)
+    {
+        return;
+    }
+
+    RETURN_LONG(Z_H3_ENTITY_INDEX_P(getThis())->record_count);
 }
 
-PHP_FUNCTION(getPentagonIndexes)
+// Returns the ids of the entities within k steps of origin.
+static void php_h3_entity_index_within(php_h3_entity_index *index, H3Index origin, zend_long k, zend_long format, zval *return_value)
 {
-    zend_long res;
+    php_h3_output out;
+    H3Index *disk, single = origin;
+    int disk_size = 1;
+    size_t total = 0, count = 0;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &res) == FAILURE)
+    if (php_h3_check_k(k) == FAILURE)
     {
-        return;
+        RETURN_FALSE;
+    }
+
+    if (k == 0)
+    {
+        disk = &single;
+    }
+    else
+    {
+        disk_size = maxKringSize(k);
+        disk = (H3Index *)php_h3_arena_alloc(disk_size * sizeof(H3Index), 1);
+        kRing(origin, k, disk);
     }
 
-    //int indexcount=pentagonIndexCount();
-    H3Index outs[12];
+    // count first so the result is allocated once
+    for (int i = 0; i < disk_size; i++)
+    {
+        size_t b = php_h3_entity_index_bucket(index, disk[i]);
+
+        if (b < index->bucket_count)
+        {
+            total += index->buckets[b].count;
+        }
+    }
 
-    getPentagonIndexes(res, outs);
+    H3Index *ids = php_h3_output_init(&out, format, total);
 
-    array_init(return_value);
-    for (int i = 0; i < 12; i++)
+    for (int i = 0; i < disk_size && count < total; i++)
     {
-        add_index_long(return_value, i, outs[i]);
+        size_t b = php_h3_entity_index_bucket(index, disk[i]);
+
+        if (b < index->bucket_count)
+        {
+            for (uint32_t j = 0; j < index->buckets[b].count; j++)
+            {
+                ids[count++] = (H3Index)index->records[index->buckets[b].members[j]].id;
+            }
+        }
     }
-}
 
-PHP_FUNCTION(pentagonIndexCount)
-{
-    //RETURN_LONG(pentagonIndexCount());
-    RETURN_LONG(12);
+    php_h3_output_return(&out, count, return_value);
+
+    // after the output so the arena gets both back
+    if (disk != &single)
+    {
+        php_h3_arena_free(disk);
+    }
 }
 
-PHP_FUNCTION(pointDistKm)
+PHP_METHOD(H3EntityIndex, members)
 {
-    zval *a_zval, *b_zval;
-    GeoCoord a, b;
-    double kilometers;
+    zend_long cell, format = PHP_H3_FORMAT_ARRAY;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "aa", &a_zval, &b_zval) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "l|l", &cell, &format) == FAILURE)
     {
         return;
     }
 
-    a.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(a_zval), "lat", 3)));
-    a.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(a_zval), "lon", 3)));
-    b.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(b_zval), "lat", 3)));
-    b.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(b_zval), "lon", 3)));
-
-    kilometers = pointDistKm(&a, &b);
-
-    RETURN_DOUBLE(kilometers);
+    php_h3_entity_index_within(Z_H3_ENTITY_INDEX_P(getThis()), cell, 0, format, return_value);
 }
 
-PHP_FUNCTION(pointDistM)
+PHP_METHOD(H3EntityIndex, within)
 {
-    zval *a_zval, *b_zval;
-    GeoCoord a, b;
-    double meters;
+    zend_long cell, k, format = PHP_H3_FORMAT_ARRAY;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "aa", &a_zval, &b_zval) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ll|l", &cell, &k, &format) == FAILURE)
     {
         return;
     }
 
-    a.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(a_zval), "lat", 3)));
-    a.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(a_zval), "lon", 3)));
-    b.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(b_zval), "lat", 3)));
-    b.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(b_zval), "lon", 3)));
-
-    meters = pointDistM(&a, &b);
-
-    RETURN_DOUBLE(meters);
+    php_h3_entity_index_within(Z_H3_ENTITY_INDEX_P(getThis()), cell, k, format, return_value);
 }
 
-PHP_FUNCTION(pointDistRads)
+PHP_METHOD(H3EntityIndex, near)
 {
-    zval *a_zval, *b_zval;
-    GeoCoord a, b;
-    double rads;
+    double lat, lon;
+    zend_long k, format = PHP_H3_FORMAT_ARRAY;
+    GeoCoord location;
+    php_h3_entity_index *index = Z_H3_ENTITY_INDEX_P(getThis());
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS(), "aa", &a_zval, &b_zval) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "ddl|l", &lat, &lon, &k, &format) == FAILURE)
     {
         return;
     }
 
-    a.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(a_zval), "lat", 3)));
-    a.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(a_zval), "lon", 3)));
-    b.lat = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(b_zval), "lat", 3)));
-    b.lon = degsToRads(Z_DVAL_P(zend_hash_str_find(Z_ARRVAL_P(b_zval), "lon", 3)));
+    location.lat = degsToRads(lat);
+    location.lon = degsToRads(lon);
 
-    rads = pointDistRads(&a, &b);
+    php_h3_entity_index_within(index, geoToH3(&location, index->res), k, format, return_value);
+}
 
-    RETURN_DOUBLE(rads);
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3entityindex_construct, 0, 0, 1)
+    ZEND_ARG_INFO(0, res)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3entityindex_void, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3entityindex_id, 0, 0, 1)
+    ZEND_ARG_INFO(0, id)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3entityindex_set, 0, 0, 3)
+    ZEND_ARG_INFO(0, id)
+    ZEND_ARG_INFO(0, lat)
+    ZEND_ARG_INFO(0, lon)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3entityindex_set_cell, 0, 0, 2)
+    ZEND_ARG_INFO(0, id)
+    ZEND_ARG_INFO(0, cell)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3entityindex_members, 0, 0, 1)
+    ZEND_ARG_INFO(0, cell)
+    ZEND_ARG_INFO(0, format)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3entityindex_within, 0, 0, 2)
+    ZEND_ARG_INFO(0, cell)
+    ZEND_ARG_INFO(0, k)
+    ZEND_ARG_INFO(0, format)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_h3entityindex_near, 0, 0, 3)
+    ZEND_ARG_INFO(0, lat)
+    ZEND_ARG_INFO(0, lon)
+    ZEND_ARG_INFO(0, k)
+    ZEND_ARG_INFO(0, format)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry php_h3_entity_index_methods[] = {
+    PHP_ME(H3EntityIndex, __construct, arginfo_h3entityindex_construct, ZEND_ACC_PUBLIC)
+    PHP_ME(H3EntityIndex, set, arginfo_h3entityindex_set, ZEND_ACC_PUBLIC)
+    PHP_ME(H3EntityIndex, setCell, arginfo_h3entityindex_set_cell, ZEND_ACC_PUBLIC)
+    PHP_ME(H3EntityIndex, remove, arginfo_h3entityindex_id, ZEND_ACC_PUBLIC)
+    PHP_ME(H3EntityIndex, get, arginfo_h3entityindex_id, ZEND_ACC_PUBLIC)
+    PHP_ME(H3EntityIndex, has, arginfo_h3entityindex_id, ZEND_ACC_PUBLIC)
+    PHP_ME(H3EntityIndex, count, arginfo_h3entityindex_void, ZEND_ACC_PUBLIC)
+    PHP_ME(H3EntityIndex, members, arginfo_h3entityindex_members, ZEND_ACC_PUBLIC)
+    PHP_ME(H3EntityIndex, within, arginfo_h3entityindex_within, ZEND_ACC_PUBLIC)
+    PHP_ME(H3EntityIndex, near, arginfo_h3entityindex_near, ZEND_ACC_PUBLIC)
+    PHP_FE_END};
+
+static void php_h3_register_entity_index_class(void)
+{
+    zend_class_entry ce;
+
+    INIT_CLASS_ENTRY(ce, "H3EntityIndex", php_h3_entity_index_methods);
+    php_h3_entity_index_ce = zend_register_internal_class(&ce);
+    php_h3_entity_index_ce->ce_flags |= ZEND_ACC_FINAL;
+    php_h3_entity_index_ce->create_object = php_h3_entity_index_create;
+
+#if PHP_VERSION_ID >= 70200
+    zend_class_implements(php_h3_entity_index_ce, 1, zend_ce_countable);
+#else
+    zend_class_implements(php_h3_entity_index_ce, 1, spl_ce_Countable);
+#endif
+
+    memcpy(&php_h3_entity_index_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    php_h3_entity_index_handlers.offset = XtOffsetOf(php_h3_entity_index, std);
+    php_h3_entity_index_handlers.free_obj = php_h3_entity_index_free;
+    php_h3_entity_index_handlers.clone_obj = NULL;
 }
+/* }}} */
 
 /* The previous line is meant for vim and emacs, so it can correctly fold and
    unfold functions in source code. See the corresponding marks just before
@@ -1441,22 +8011,53 @@ PHP_FUNCTION(pointDistRads)
 
 /* {{{ php_h3_init_globals
  */
-/* Uncomment this function if you have INI entries
 static void php_h3_init_globals(zend_h3_globals *h3_globals)
 {
-    h3_globals->global_value = 0;
-    h3_globals->global_string = NULL;
+    memset(h3_globals, 0, sizeof(zend_h3_globals));
+}
+/* }}} */
+
+/* {{{ php_h3_shutdown_globals
+ */
+static void php_h3_shutdown_globals(zend_h3_globals *h3_globals)
+{
+    if (h3_globals->arena != NULL)
+    {
+        pefree(h3_globals->arena, 1);
+        h3_globals->arena = NULL;
+    }
 }
-*/
 /* }}} */
 
 /* {{{ PHP_MINIT_FUNCTION
  */
 PHP_MINIT_FUNCTION(h3)
 {
-    /* If you have INI entries, uncomment these lines
+    REGISTER_LONG_CONSTANT("H3_FORMAT_ARRAY", PHP_H3_FORMAT_ARRAY, CONST_CS | CONST_PERSISTENT);
+    REGISTER_LONG_CONSTANT("H3_FORMAT_PACKED", PHP_H3_FORMAT_PACKED, CONST_CS | CONST_PERSISTENT);
+    REGISTER_LONG_CONSTANT("H3_FORMAT_SET", PHP_H3_FORMAT_SET, CONST_CS | CONST_PERSISTENT);
+
+    php_h3_register_index_set_class();
+    php_h3_register_polygon_class();
+    php_h3_register_polyfill_iterator_class();
+    php_h3_register_cell_map_class();
+    php_h3_register_point_index_class();
+    php_h3_register_entity_index_class();
+
+    ZEND_INIT_MODULE_GLOBALS(h3, php_h3_init_globals, php_h3_shutdown_globals);
     REGISTER_INI_ENTRIES();
-    */
+
+    php_h3_tables_startup();
+
+    if (H3_G(stats_enabled))
+    {
+        php_h3_stats_startup();
+    }
+
+#ifdef PHP_H3_SHM_CACHE
+    php_h3_shm_startup(H3_G(shm_cache_size), H3_G(shm_cache_entry_size));
+#endif
+
     return SUCCESS;
 }
 /* }}} */
@@ -1465,9 +8066,15 @@ PHP_MINIT_FUNCTION(h3)
  */
 PHP_MSHUTDOWN_FUNCTION(h3)
 {
-    /* uncomment this line if you have INI entries
+#ifdef PHP_H3_SHM_CACHE
+    php_h3_shm_shutdown();
+#endif
+    php_h3_tables_shutdown();
     UNREGISTER_INI_ENTRIES();
-    */
+#ifndef ZTS
+    php_h3_shutdown_globals(&h3_globals);
+#endif
+
     return SUCCESS;
 }
 /* }}} */
@@ -1480,6 +8087,9 @@ PHP_RINIT_FUNCTION(h3)
 #if defined(COMPILE_DL_H3) && defined(ZTS)
     ZEND_TSRMLS_CACHE_UPDATE();
 #endif
+    zend_hash_init(&H3_G(polyfill_cache), 8, NULL, ZVAL_PTR_DTOR, 0);
+    H3_G(polyfill_cache_bytes) = 0;
+
     return SUCCESS;
 }
 /* }}} */
@@ -1489,21 +8099,76 @@ PHP_RINIT_FUNCTION(h3)
  */
 PHP_RSHUTDOWN_FUNCTION(h3)
 {
+    zend_hash_destroy(&H3_G(polyfill_cache));
+    H3_G(polyfill_cache_bytes) = 0;
+    php_h3_arena_reset();
+
     return SUCCESS;
 }
 /* }}} */
 
+static void php_h3_info_print_long(const char *name, zend_long value)
+{
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), ZEND_LONG_FMT, value);
+    php_info_print_table_row(2, name, buf);
+}
+
 /* {{{ PHP_MINFO_FUNCTION
  */
 PHP_MINFO_FUNCTION(h3)
 {
     php_info_print_table_start();
     php_info_print_table_header(2, "h3 support", "enabled");
+    php_h3_info_print_long("polyfill cache hits", H3_G(polyfill_cache_hits));
+    php_h3_info_print_long("polyfill cache misses", H3_G(polyfill_cache_misses));
+    php_h3_info_print_long("polyfill cache bytes", H3_G(polyfill_cache_bytes));
+#ifdef PHP_H3_SHM_CACHE
+    if (php_h3_shm != NULL)
+    {
+        php_h3_info_print_long("shared cache slots", (zend_long)(php_h3_shm->sets * php_h3_shm->ways));
+        php_h3_info_print_long("shared cache hits", (zend_long)__atomic_load_n(&php_h3_shm->hits, __ATOMIC_RELAXED));
+        php_h3_info_print_long("shared cache misses", (zend_long)__atomic_load_n(&php_h3_shm->misses, __ATOMIC_RELAXED));
+        php_h3_info_print_long("shared cache stores", (zend_long)__atomic_load_n(&php_h3_shm->stores, __ATOMIC_RELAXED));
+        php_h3_info_print_long("shared cache stores skipped (lock busy)", (zend_long)__atomic_load_n(&php_h3_shm->busy, __ATOMIC_RELAXED));
+        php_h3_info_print_long("shared cache stale locks recovered", (zend_long)__atomic_load_n(&php_h3_shm->recovered, __ATOMIC_RELAXED));
+    }
+#endif
+#ifdef PHP_H3_THREADS
+    php_info_print_table_row(2, "worker threads", "enabled");
+#else
+    php_info_print_table_row(2, "worker threads", "disabled");
+#endif
+    php_h3_info_print_long("scratch arena high-water mark", (zend_long)H3_G(arena_high_water));
+    php_h3_info_print_long("scratch arena fallbacks", H3_G(arena_fallbacks));
+    php_info_print_table_row(2, "call statistics", php_h3_stats_count > 0 ? "enabled" : "disabled");
     php_info_print_table_end();
 
-    /* Remove comments if you have entries in php.ini
+    if (php_h3_stats_count > 0)
+    {
+        php_info_print_table_start();
+        php_info_print_table_header(5, "function", "calls", "time (ms)", "cells", "bytes");
+        for (size_t i = 0; i < php_h3_stats_count; i++)
+        {
+            php_h3_stats_entry *entry = &H3_G(stats)[i];
+            char calls[32], time[32], cells[32], bytes[32];
+
+            if (entry->calls == 0)
+            {
+                continue;
+            }
+
+            snprintf(calls, sizeof(calls), ZEND_ULONG_FMT, entry->calls);
+            snprintf(time, sizeof(time), "%.3f", entry->ns / 1e6);
+            snprintf(cells, sizeof(cells), ZEND_ULONG_FMT, entry->cells);
+            snprintf(bytes, sizeof(bytes), ZEND_ULONG_FMT, entry->bytes);
+            php_info_print_table_row(5, ZSTR_VAL(php_h3_stats_names[i]), calls, time, cells, bytes);
+        }
+        php_info_print_table_end();
+    }
+
     DISPLAY_INI_ENTRIES();
-    */
 }
 /* }}} */
 
@@ -1517,8 +8182,11 @@ const zend_function_entry h3_functions[] = {
 
     //Indexing functions
     PHP_FE(geoToH3,		NULL)
+    PHP_FE(geoToH3Batch,		NULL)
     PHP_FE(h3ToGeo,		NULL)
     PHP_FE(h3ToGeoBoundary,		NULL)
+    PHP_FE(h3ToGeoBatch,		NULL)
+    PHP_FE(h3ToGeoBoundaryBatch,		NULL)
     
     //Index inspection functions
     PHP_FE(h3GetResolution,		NULL)
@@ -1533,6 +8201,7 @@ const zend_function_entry h3_functions[] = {
     
     //Grid traversal functions
     PHP_FE(kRing,		NULL)
+    PHP_FE(kRingFast,		arginfo_kRingFast)
     PHP_FE(maxKringSize,		NULL)
     PHP_FE(kRingDistances,		NULL)
     PHP_FE(hexRange,		NULL)
@@ -1542,6 +8211,8 @@ const zend_function_entry h3_functions[] = {
     PHP_FE(h3Line,		NULL)
     PHP_FE(h3LineSize,		NULL)
     PHP_FE(h3Distance,		NULL)
+    PHP_FE(h3DistanceBatch,		NULL)
+    PHP_FE(h3LineSizeBatch,		NULL)
     PHP_FE(experimentalH3ToLocalIj,		NULL)
     PHP_FE(experimentalLocalIjToH3,		NULL)
     
@@ -1553,6 +8224,11 @@ const zend_function_entry h3_functions[] = {
     PHP_FE(h3Compact,		NULL)
     PHP_FE(uncompact,		NULL)
     PHP_FE(maxUncompactSize,		NULL)
+    PHP_FE(h3SetUnion,		NULL)
+    PHP_FE(h3SetIntersection,		NULL)
+    PHP_FE(h3SetDifference,		NULL)
+    PHP_FE(h3Rollup,		NULL)
+    PHP_FE(h3SetToAdjacency,		NULL)
     
     //Unidirectional edge functions
     PHP_FE(h3IndexesAreNeighbors,		NULL)
@@ -1566,8 +8242,14 @@ const zend_function_entry h3_functions[] = {
     
     //Region functions
     PHP_FE(polyfill,		NULL)
+    PHP_FE(polyfillChunked,		NULL)
     PHP_FE(maxPolyfillSize,		NULL)
     PHP_FE(h3SetToLinkedGeo,		NULL)
+    PHP_FE(h3SetToGeoJson,		NULL)
+    PHP_FE(h3SetToWkb,		NULL)
+    PHP_FE(h3ToGeoBoundaryGeoJson,		NULL)
+    PHP_FE(h3ToGeoBoundaryWkb,		NULL)
+    PHP_FE(h3ToMvt,		NULL)
     
     //Miscellaneous H3 functions
     PHP_FE(degsToRads,		NULL)
@@ -1590,6 +8272,9 @@ const zend_function_entry h3_functions[] = {
     PHP_FE(pointDistKm,		NULL)
     PHP_FE(pointDistM,		NULL)
     PHP_FE(pointDistRads,		NULL)
+    PHP_FE(h3_stats,		NULL)
+    PHP_FE(h3_stats_reset,		NULL)
+    PHP_FE(h3_arena_stats,		NULL)
 
     PHP_FE_END /* Must be the last line in h3_functions[] */
 };
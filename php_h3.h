@@ -25,6 +25,27 @@ extern zend_module_entry h3_module_entry;
 
 #define PHP_H3_VERSION "0.1.0" /* Replace with version number for your extension */
 
+/* Same factors as libh3's M_PI_180 and M_180_PI, so batch conversions match
+   degsToRads() and radsToDegs() */
+#define PHP_H3_DEG_TO_RAD (3.14159265358979323846 / 180.0)
+#define PHP_H3_RAD_TO_DEG (180.0 / 3.14159265358979323846)
+
+/* Result formats for set-returning functions (H3_FORMAT_* constants) */
+#define PHP_H3_FORMAT_ARRAY 0
+#define PHP_H3_FORMAT_PACKED 1
+#define PHP_H3_FORMAT_SET 2
+
+/* Call statistics collected per function when h3.stats is on */
+#define PHP_H3_STATS_MAX_FUNCTIONS 128
+
+typedef struct _php_h3_stats_entry
+{
+	zend_ulong calls;
+	zend_ulong ns;
+	zend_ulong cells;
+	zend_ulong bytes;
+} php_h3_stats_entry;
+
 #ifdef PHP_WIN32
 #	define PHP_H3_API __declspec(dllexport)
 #elif defined(__GNUC__) && __GNUC__ >= 4
@@ -37,15 +58,32 @@ extern zend_module_entry h3_module_entry;
 #include "TSRM.h"
 #endif
 
-/*
-  	Declare any global variables you may need between the BEGIN
-	and END macros here:
-
 ZEND_BEGIN_MODULE_GLOBALS(h3)
-	zend_long  global_value;
-	char *global_string;
+	/* per-request polyfill() result cache, bounded by h3.polyfill_cache_size */
+	zend_long polyfill_cache_size;
+	HashTable polyfill_cache;
+	size_t polyfill_cache_bytes;
+	zend_long polyfill_cache_hits;
+	zend_long polyfill_cache_misses;
+	/* cross-process cache in shared memory, mapped in MINIT */
+	zend_long shm_cache_size;
+	zend_long shm_cache_entry_size;
+	/* default number of threads polyfill() may use for large polygons */
+	zend_long polyfill_threads;
+	/* per-call scratch arena of h3.arena_size bytes, allocated on first use */
+	zend_long arena_size;
+	char *arena;
+	size_t arena_used;
+	size_t arena_top;
+	size_t arena_high_water;
+	zend_long arena_fallbacks;
+	void *arena_overflow;
+	/* per-function call statistics, enabled by h3.stats */
+	zend_bool stats_enabled;
+	php_h3_stats_entry stats[PHP_H3_STATS_MAX_FUNCTIONS];
 ZEND_END_MODULE_GLOBALS(h3)
-*/
+
+ZEND_EXTERN_MODULE_GLOBALS(h3)
 
 /* Always refer to the globals in your function as H3_G(variable).
    You are encouraged to rename these macros something shorter, see
@@ -64,8 +102,11 @@ static int le_h3_boundary;
 
 //Indexing functions
 PHP_FUNCTION(geoToH3);
+PHP_FUNCTION(geoToH3Batch);
 PHP_FUNCTION(h3ToGeo);
 PHP_FUNCTION(h3ToGeoBoundary);
+PHP_FUNCTION(h3ToGeoBatch);
+PHP_FUNCTION(h3ToGeoBoundaryBatch);
 
 //Index inspection functions
 PHP_FUNCTION(h3GetResolution);
@@ -80,6 +121,7 @@ PHP_FUNCTION(maxFaceCount);
 
 //Grid traversal functions
 PHP_FUNCTION(kRing);
+PHP_FUNCTION(kRingFast);
 PHP_FUNCTION(maxKringSize);
 PHP_FUNCTION(kRingDistances);
 PHP_FUNCTION(hexRange);
@@ -89,6 +131,8 @@ PHP_FUNCTION(hexRing);
 PHP_FUNCTION(h3Line);
 PHP_FUNCTION(h3LineSize);
 PHP_FUNCTION(h3Distance);
+PHP_FUNCTION(h3DistanceBatch);
+PHP_FUNCTION(h3LineSizeBatch);
 PHP_FUNCTION(experimentalH3ToLocalIj);
 PHP_FUNCTION(experimentalLocalIjToH3);
 
@@ -100,6 +144,11 @@ PHP_FUNCTION(h3ToCenterChild);
 PHP_FUNCTION(h3Compact);
 PHP_FUNCTION(uncompact);
 PHP_FUNCTION(maxUncompactSize);
+PHP_FUNCTION(h3SetUnion);
+PHP_FUNCTION(h3SetIntersection);
+PHP_FUNCTION(h3SetDifference);
+PHP_FUNCTION(h3Rollup);
+PHP_FUNCTION(h3SetToAdjacency);
 
 //Unidirectional edge functions
 PHP_FUNCTION(h3IndexesAreNeighbors);
@@ -113,8 +162,14 @@ PHP_FUNCTION(getH3UnidirectionalEdgeBoundary);
 
 //Region functions
 PHP_FUNCTION(polyfill);
+PHP_FUNCTION(polyfillChunked);
 PHP_FUNCTION(maxPolyfillSize);
 PHP_FUNCTION(h3SetToLinkedGeo);
+PHP_FUNCTION(h3SetToGeoJson);
+PHP_FUNCTION(h3SetToWkb);
+PHP_FUNCTION(h3ToGeoBoundaryGeoJson);
+PHP_FUNCTION(h3ToGeoBoundaryWkb);
+PHP_FUNCTION(h3ToMvt);
 
 //Miscellaneous H3 functions
 PHP_FUNCTION(degsToRads);
@@ -138,6 +193,11 @@ PHP_FUNCTION(pointDistKm);
 PHP_FUNCTION(pointDistM);
 PHP_FUNCTION(pointDistRads);
 
+//Instrumentation functions
+PHP_FUNCTION(h3_stats);
+PHP_FUNCTION(h3_stats_reset);
+PHP_FUNCTION(h3_arena_stats);
+
 /*
  * Local variables:
  * tab-width: 4
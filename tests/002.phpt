@@ -0,0 +1,28 @@
+--TEST--
+Check h3_stats() counters with h3.stats on
+--SKIPIF--
+<?php if (!extension_loaded("h3")) print "skip"; ?>
+--INI--
+h3.stats=1
+--FILE--
+<?php
+$index = geoToH3(40.689167, -74.044444, 10);
+kRing($index, 1);
+kRing($index, 1, H3_FORMAT_PACKED);
+
+$stats = h3_stats();
+var_dump($stats["kRing"]["calls"], $stats["kRing"]["cells"], $stats["kRing"]["bytes"], $stats["kRing"]["time_ns"] > 0);
+var_dump($stats["geoToH3"]["calls"], isset($stats["h3_stats"]));
+
+h3_stats_reset();
+var_dump(h3_stats());
+?>
+--EXPECT--
+int(2)
+int(7)
+int(56)
+bool(true)
+int(1)
+bool(false)
+array(0) {
+}
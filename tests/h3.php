@@ -4,10 +4,18 @@ $index = geoToH3(40.689167, -74.044444, 10);
 
 var_dump($index);
 
+var_dump(geoToH3Batch([40.689167, 37.775938], [-74.044444, -122.416648], 10));
+
+var_dump(geoToH3Batch(pack('dd', 40.689167, -74.044444), 10) === [$index]);
+
 var_dump(h3ToGeo($index));
 
 var_dump(h3ToGeoBoundary($index));
 
+var_dump(array_values(unpack('d*', h3ToGeoBatch([$index]))) === array_values(h3ToGeo($index)));
+$boundaries = h3ToGeoBoundaryBatch([$index, $index]);
+var_dump(array_values(unpack('L*', $boundaries['offsets'])), count(unpack('d*', $boundaries['verts'])) === 4 * count(h3ToGeoBoundary($index)));
+
 var_dump(h3GetResolution($index));
 
 var_dump(h3GetBaseCell($index));
@@ -24,8 +32,54 @@ var_dump(kRing($index, 5));
 
 var_dump(maxKringSize(5));
 
+var_dump(array_values(unpack('P*', kRing($index, 1, H3_FORMAT_PACKED))) === kRing($index, 1));
+
+$set = kRing($index, 1, H3_FORMAT_SET);
+var_dump(count($set), iterator_to_array($set) === kRing($index, 1), $set->toArray() === kRing($index, 1));
+var_dump(uncompact(h3Compact($set, H3_FORMAT_SET), 10, H3_FORMAT_SET) instanceof H3IndexSet);
+
+$counts = new H3CellMap();
+$counts->incrementBatch(kRing($index, 1));
+$counts->increment($index, 2);
+var_dump(count($counts), $counts->get($index), $counts->binPoints([40.689167, 40.689167], [-74.044444, -74.044444], 10), $counts->get($index));
+var_dump($counts->binPoints([40.689167, NAN], [-74.044444, -74.044444], 10), $counts->binPoints([40.689167], [-74.044444], 16));
+$sums = new H3CellMap(H3CellMap::FLOAT);
+$sums->merge($counts);
+var_dump($sums->get($index), $sums->remove($index), $sums->has($index), count($sums->keys(H3_FORMAT_SET)));
+
+$points = new H3PointIndex([40.689167, 40.6892, 40.70, 41.5], [-74.044444, -74.0445, -74.02, -74.0], 9);
+var_dump(count($points), array_keys($points->radius(40.689167, -74.044444, 1.0)), array_keys($points->kNearest(40.689167, -74.044444, 3)));
+var_dump(array_values(unpack('P*', $points->kNearest(40.689167, -74.044444, 2, INF, H3_FORMAT_PACKED))) === [0, 1]);
+$around = array_map('h3ToGeo', kRing(getPentagonIndexes(7)[0], 6));
+$nearPentagon = new H3PointIndex(array_column($around, 'lat'), array_column($around, 'lon'), 8);
+$distances = array_map(function ($point) use ($around) { return pointDistKm($point, $around[0]); }, $around);
+asort($distances);
+var_dump(array_keys($nearPentagon->kNearest($around[0]['lat'], $around[0]['lon'], 10)) === array_slice(array_keys($distances), 0, 10));
+
+$couriers = new H3EntityIndex(9);
+$couriers->set(7, 40.689167, -74.044444);
+$couriers->set(8, 40.6892, -74.0445);
+$couriers->set(7, 40.70, -74.02);
+var_dump(count($couriers), $couriers->within($couriers->get(8), 1), $couriers->near(40.70, -74.02, 0), $couriers->remove(7), $couriers->has(7));
+var_dump($couriers->within($couriers->get(8), 30000), $couriers->near(40.70, -74.02, 30000));
+
 var_dump(kRingDistances($index, 5));
 
+$pentagon = getPentagonIndexes(5)[0];
+var_dump(count(kRing($pentagon, 1)), count(kRingDistances($pentagon, 1)[1]), in_array(0, h3ToChildren($pentagon, 6), true));
+
+var_dump(h3IsPentagon($pentagon), h3IsPentagon(h3ToChildren($pentagon, 6)[1]), count(getRes0Indexes()), array_values(unpack('P*', getPentagonIndexes(5, H3_FORMAT_PACKED))) === getPentagonIndexes(5));
+
+var_dump(kRingFast($index, 2, $usedFallback) == kRing($index, 2), $usedFallback, count(kRingFast($pentagon, 1, $usedFallback)), $usedFallback);
+// hexRange() would succeed here, but the pentagon test sends it to the walk
+$ring = kRingDistances($pentagon, 3);
+$nearPentagon = $ring[0][array_search(3, $ring[1])];
+$fast = kRingFast($nearPentagon, 1, $usedFallback);
+$slow = kRing($nearPentagon, 1);
+sort($fast);
+sort($slow);
+var_dump(hexRange($nearPentagon, 1) !== false, $usedFallback, $fast === $slow);
+
 var_dump(hexRange($index, 5));
 
 var_dump(hexRangeDistances($index, 5));
@@ -36,8 +90,14 @@ var_dump(hexRanges([$index, $index1], 5));
 
 var_dump(hexRing($index, 5));
 
+var_dump(hexRing($index, -1), kRing($index, -1));
+
 var_dump(h3Distance($index, $index1));
 
+var_dump(unpack('l*', h3DistanceBatch($index, kRing($index, 1))));
+
+var_dump(unpack('l*', h3LineSizeBatch([$index, $index], [$index, $index1])));
+
 var_dump(h3ToParent($index, 5));
 
 var_dump(h3ToChildren($index, 2));
@@ -71,6 +131,18 @@ var_dump(getH3UnidirectionalEdgeBoundary($index));
 var_dump($compacts = h3Compact([$index, $index1]));
 var_dump(uncompact($compacts, 2));
 var_dump(maxUncompactSize($compacts, 2));
+var_dump(uncompact(pack('P*', ...$compacts), 11, H3_FORMAT_PACKED) === pack('P*', ...uncompact($compacts, 11)));
+
+$parent = h3ToParent($index, 9);
+var_dump(h3SetIntersection([$parent], h3ToChildren($parent, 10)) === h3ToChildren($parent, 10));
+var_dump(h3SetUnion([$parent], h3ToChildren($parent, 10)) === [$parent]);
+var_dump(h3SetDifference([$parent], [$index], true));
+
+$rollup = h3Rollup(h3ToChildren($parent, 10), array_fill(0, 7, 2.0), [9, 8]);
+var_dump(unpack('P', $rollup[9]['cells'])[1] === $parent, unpack('P', $rollup[8]['count'])[1], unpack('d', $rollup[9]['sum'])[1], unpack('d', $rollup[8]['max'])[1]);
+
+$graph = h3SetToAdjacency(kRing($index, 1), true);
+var_dump(unpack('P*', $graph['offsets']), count(unpack('P*', $graph['neighbors'])), strlen($graph['lengths']) / 8);
 
 $lat=40.689167;$lon=-74.044444;
 $str="8a2a1072b59ffff";
@@ -106,6 +178,15 @@ var_dump(h3SetToLinkedGeo([0x89283082813ffff, 0x8928308281bffff, 0x8928308280bff
 0x89283082837ffff, 0x892830828afffff, 0x892830828a3ffff,
 0x892830828b3ffff, 0x89283082887ffff, 0x89283082883ffff]));
 
+$outline = json_decode(h3SetToGeoJson([$index]), true);
+var_dump($outline['type'], count($outline['coordinates'][0][0]) === count(h3ToGeoBoundary($index)) + 1);
+var_dump(strlen(h3SetToWkb([$index])) === 9 + 13 + 16 * (count(h3ToGeoBoundary($index)) + 1));
+var_dump(json_decode(h3ToGeoBoundaryGeoJson([$index]), true)['features'][0]['id'] === h3ToString($index));
+var_dump(strlen(h3ToGeoBoundaryWkb([$index, $index])) === 9 + 2 * (13 + 16 * (count(h3ToGeoBoundary($index)) + 1)));
+var_dump(strlen(h3ToMvt([$index], 14, 4822, 6161, ['value' => [1.5]])) > 0, h3ToMvt([$index], 14, 0, 0) === h3ToMvt([], 14, 0, 0));
+$antimeridian = geoToH3(10, 179.99, 0);
+var_dump(h3ToMvt([$antimeridian], 1, 0, 0) !== h3ToMvt([], 1, 0, 0), h3ToMvt([$antimeridian], 1, 1, 0) !== h3ToMvt([], 1, 1, 0));
+
 
 $geiface=[
 "geofence"=>
@@ -126,4 +207,25 @@ $a=maxPolyfillSize($geiface,9);
 if($a==5613)
 echo "got expected max polyfill size";
 
+$polygon = new H3Polygon($geiface);
+var_dump(maxPolyfillSize($polygon, 9) === $a, polyfill($polygon, 7) === polyfill($geiface, 7));
+$serial = array_values(array_filter(polyfill($geiface, 11)));
+sort($serial);
+$parallel = polyfill($polygon, 11, H3_FORMAT_ARRAY, 4);
+sort($parallel);
+var_dump($parallel === $serial);
+
+$chunked = [];
+foreach (polyfillChunked($polygon, 11, 1000) as $chunk) {
+    $chunked = array_merge($chunked, $chunk);
+}
+sort($chunked);
+var_dump($chunked === $serial);
+var_dump($polygon->contains(37.80, -122.45), $polygon->contains(37.775, -122.44), $polygon->getBoundingBox());
+
+h3_stats_reset();
+var_dump(h3_stats());
+$arena = h3_arena_stats();
+var_dump($arena["used"] <= $arena["high_water"], $arena["high_water"] <= $arena["size"]);
+
 echo "hello world\n";